@@ -0,0 +1,63 @@
+/************************************************************************************************
+ * IndexKey text parsing microbenchmark: IndexKey(const QString &) vs IndexKey::parse()
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+ * license: GPLv3 2007 - https://www.gnu.org/licenses/gpl-3.0.html
+************************************************************************************************/
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QDebug>
+#include "../../src/qtarantool.h"
+
+using namespace QTNT;
+
+int main(int argc, char *argv[])
+{
+QCoreApplication a(argc, argv);
+const int rounds =(argc > 1 ? atoi(argv[1]) : 100000);
+const QStringList keys ={
+		"{152}",
+		"{\"test value\"}",
+		"{3.14159265359}",
+		"{333, 2.71828, \"text\", true}",
+		"{29, 01, 2023}",
+		"{286, \"test\", \"текст\", -3.086}",
+		"{500, {{{555, 666}, 666}, 777}, 888, {600, {700, {\"800\"}}}, 900}"
+	};
+
+	qDebug("%d rounds of %d keys", rounds, keys.size());
+	// the same structure
+	for(const auto &k : keys)
+	{
+	int errorPos =0;
+	const IndexKey parsed =IndexKey::parse(k, &errorPos);
+
+		qDebug("%s %s", (parsed == IndexKey(k) && errorPos < 0) ? "OK  " : "DIFF", parsed.text().toUtf8().data());
+	}
+
+QElapsedTimer tmr;
+qint64 size =0; // keeps the results used
+
+	tmr.start();
+
+	for(int r =0; r < rounds; r++)
+		for(const auto &k : keys)
+			size +=IndexKey(k).size();
+
+const qint64 nsOld =tmr.nsecsElapsed();
+
+	tmr.restart();
+
+	for(int r =0; r < rounds; r++)
+		for(const auto &k : keys)
+			size +=IndexKey::parse(k).size();
+
+const qint64 nsNew =tmr.nsecsElapsed();
+const double keysTotal =double(rounds) * keys.size();
+
+	qDebug("IndexKey(QString) : %8.1f ns/key", nsOld / keysTotal);
+	qDebug("IndexKey::parse() : %8.1f ns/key (x%.1f)", nsNew / keysTotal, double(nsOld) / qMax(nsNew, qint64(1)));
+	qDebug("(%lld)", size);
+
+return(0);
+}
@@ -166,7 +166,17 @@ MainWindow::on_GetClicked(const QString &indexName, const int iOperatorFrom, con
 
 	statusBar->showMessage("");
 
-const QVariant &data =tnt.getData(CurrentSpaceName, {(OPERATOR)iOperatorFrom, Key(keyFrom), indexName}, {(OPERATOR)iOperatorTo, Key(keyTo)});
+int errorFrom =-1, errorTo =-1;
+const Key from =Key::parse(keyFrom, &errorFrom), to =Key::parse(keyTo, &errorTo);
+
+	if(errorFrom >= 0 || errorTo >= 0)
+	{
+		statusBar->showMessage(errorFrom >= 0 ? tr("Key error at position %1").arg(errorFrom) : tr("Key 'To' error at position %1").arg(errorTo));
+
+	return;
+	}
+
+const QVariant &data =tnt.getData(CurrentSpaceName, {(OPERATOR)iOperatorFrom, from, indexName}, {(OPERATOR)iOperatorTo, to});
 
 	tableDetail->setData({"Spaces", CurrentSpaceName, "DATA"}, data);
 	tableDetail->resizeColumnsToContents();
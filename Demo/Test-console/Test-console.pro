@@ -11,6 +11,12 @@ CONFIG -= app_bundle
 SOURCES += \
         ../../src/lib/qmsgpack/msgpack.cpp \
 		../../src/lib/qmsgpack/msgpackcommon.cpp \
+		../../src/lib/qmsgpack/msgpackdocument.cpp \
+		../../src/lib/qmsgpack/msgpackcolumns.cpp \
+		../../src/lib/qmsgpack/msgpackjson.cpp \
+		../../src/lib/qmsgpack/msgpackstructure.cpp \
+		../../src/lib/qmsgpack/msgpackbuilder.cpp \
+		../../src/lib/qmsgpack/msgpackbufferpool.cpp \
 		../../src/lib/qmsgpack/msgpackstream.cpp \
 		../../src/lib/qmsgpack/private/pack_p.cpp \
 		../../src/lib/qmsgpack/private/qt_types_p.cpp \
@@ -19,6 +25,11 @@ SOURCES += \
 		../../src/lib/qmsgpack/stream/location.cpp \
 		../../src/lib/qmsgpack/stream/time.cpp \
         ../../src/qtarantool.cpp \
+        ../../src/writebuffer.cpp \
+        ../../src/counteraggregator.cpp \
+        ../../src/readcoalescer.cpp \
+        ../../src/tuplecache.cpp \
+        ../../src/localreplica.cpp \
         main.cpp
 
 # Default rules for deployment.
@@ -36,6 +47,12 @@ HEADERS += \
 	../../src/lib/qmsgpack/msgpack.h \
 	../../src/lib/qmsgpack/msgpack_export.h \
 	../../src/lib/qmsgpack/msgpackcommon.h \
+	../../src/lib/qmsgpack/msgpackdocument.h \
+	../../src/lib/qmsgpack/msgpackcolumns.h \
+	../../src/lib/qmsgpack/msgpackjson.h \
+	../../src/lib/qmsgpack/msgpackstructure.h \
+	../../src/lib/qmsgpack/msgpackbuilder.h \
+	../../src/lib/qmsgpack/msgpackbufferpool.h \
 	../../src/lib/qmsgpack/msgpackstream.h \
 	../../src/lib/qmsgpack/private/pack_p.h \
 	../../src/lib/qmsgpack/private/qt_types_p.h \
@@ -44,7 +61,12 @@ HEADERS += \
 	../../src/lib/qmsgpack/stream/location.h \
 	../../src/lib/qmsgpack/stream/time.h \
 	../../src/lib/QUnSocket/qunsocket.h \
-    ../../src/qtarantool.h
+    ../../src/qtarantool.h \
+    ../../src/writebuffer.h \
+    ../../src/counteraggregator.h \
+    ../../src/readcoalescer.h \
+    ../../src/tuplecache.h \
+    ../../src/localreplica.h
 
 # Set build out directory
 CONFIG(debug, debug|release) {
@@ -0,0 +1,278 @@
+/******************************************************************
+ * QTNT::CounterAggregator - client-side sums of counter increments
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+ * license: GPLv3 2007 - https://www.gnu.org/licenses/gpl-3.0.html
+******************************************************************/
+#include "counteraggregator.h"
+
+using namespace QTNT;
+
+namespace {
+// sets the field (from 1), the missing fields before it are 0
+void
+put(QVariantList &tuple, const int field, const QVariant &value)
+{
+	while(tuple.size() < field)
+		tuple.append(0);
+
+	tuple[field - 1] =value;
+}
+
+} // namespace
+
+CounterAggregator::CounterAggregator(QTarantool *tnt, const int staleness, QObject *parent) :
+	QObject(parent), tnt(tnt), Timer(this), Staleness(qMax(staleness, 0))
+{
+	Timer.setSingleShot(true);
+	connect(&Timer, &QTimer::timeout, this, &CounterAggregator::flush);
+	connect(tnt, &QTarantool::signalConnected, this, [this] { Layouts.clear(); }); // the format could be changed
+}
+
+void
+CounterAggregator::add(const QString &spaceName, const IndexKey &key, const int field, const qint64 delta)
+{
+QMutexLocker lock(&Mutex);
+
+	sum(spaceName, key, field).Int +=delta;
+}
+
+void
+CounterAggregator::addReal(const QString &spaceName, const IndexKey &key, const int field, const double delta)
+{
+QMutexLocker lock(&Mutex);
+Sum &s =sum(spaceName, key, field);
+
+	s.Real +=delta;
+	s.bReal =true;
+}
+
+void
+CounterAggregator::setInsertTuple(const QString &spaceName, const QVariantList &tuple)
+{
+QMutexLocker lock(&Mutex);
+
+	InsertTuples.insert(spaceName, tuple);
+}
+/****************************************************************************************
+ * Called under the lock. The key is decoded only when it is new.
+ * The timer and the flush are queued to the thread of the aggregator.
+****************************************************************************************/
+CounterAggregator::Sum &
+CounterAggregator::sum(const QString &spaceName, const IndexKey &key, const int field)
+{
+QHash<QByteArray, Counters> &space =Spaces[spaceName];
+const QByteArray encoded =key.encoding();
+auto it =space.find(encoded);
+
+	if(it == space.end())
+	{
+		it =space.insert(encoded, {key.values(), {}});
+		keyAdded();
+	}
+
+return(it->Fields[field]);
+}
+
+void
+CounterAggregator::keyAdded()
+{
+	if(++Keys == 1)
+		QMetaObject::invokeMethod(this, [this] { if(!Timer.isActive()) Timer.start(Staleness); }, Qt::QueuedConnection);
+
+	if(Keys >= MaxKeys && !bRequested)
+	{
+		bRequested =true;
+		QMetaObject::invokeMethod(this, [this] { flush(); }, Qt::QueuedConnection);
+	}
+}
+/****************************************************************************************
+ * Default insert tuple by the space format (cached until reconnect) and the fields
+ * of the primary key.
+****************************************************************************************/
+bool
+CounterAggregator::layout(const QString &spaceName, Layout &layout)
+{
+const auto it =Layouts.constFind(spaceName);
+
+	if(it != Layouts.constEnd())
+	{
+		layout =it.value();
+
+	return(true);
+	}
+
+const REPLY &reply =tnt->exec("local s = box.space[...]; local f, k = {}, {};"
+							  "for i, x in ipairs(s:format()) do f[i] = {x.type, x.is_nullable == true} end;"
+							  "for i, p in ipairs(s.index[0].parts) do k[i] = p.fieldno end;"
+							  "return f, k", {spaceName});
+
+	if(!reply.IsValid)
+		return(false);
+
+const QVariantList data =reply.Data[IPROTO_DATA].toList();
+
+	layout =Layout();
+
+	for(const auto &field : data.value(0).toList())
+	{
+	const QVariantList f =field.toList(); // [type, is_nullable]
+	const QString type =f.value(0).toString();
+
+		if(f.value(1).toBool())
+			layout.Tuple.append(QVariant()); // null
+		else
+		if(type == "unsigned" || type == "integer" || type == "number" || type == "scalar" || type == "any")
+			layout.Tuple.append(0);
+		else
+		if(type == "double")
+			layout.Tuple.append(0.0);
+		else
+		if(type == "boolean")
+			layout.Tuple.append(false);
+		else
+		if(type == "string")
+			layout.Tuple.append(QString(""));
+		else
+		if(type == "varbinary")
+			layout.Tuple.append(QByteArray(""));
+		else
+			layout.Tuple.append(QVariant()); // uuid, decimal, datetime...: see setInsertTuple()
+	}
+
+	for(const auto &part : data.value(1).toList())
+		layout.KeyFields.append(part.toInt());
+
+	Layouts.insert(spaceName, layout);
+
+return(true);
+}
+/****************************************************************************************
+ * The sums of the failed upserts go back for the next flush.
+****************************************************************************************/
+void
+CounterAggregator::restore(const QString &spaceName, const QHash<QByteArray, Counters> &counters)
+{
+QMutexLocker lock(&Mutex);
+QHash<QByteArray, Counters> &space =Spaces[spaceName];
+
+	for(auto c =counters.cbegin(); c != counters.cend(); ++c)
+	{
+	auto it =space.find(c.key());
+
+		if(it == space.end())
+		{
+			it =space.insert(c.key(), {c->Key, {}});
+			keyAdded();
+		}
+
+		for(auto f =c->Fields.cbegin(); f != c->Fields.cend(); ++f)
+		{
+		Sum &sum =it->Fields[f.key()];
+
+			sum.Int +=f->Int;
+			sum.Real +=f->Real;
+			sum.bReal |=f->bReal;
+		}
+	}
+}
+/****************************************************************************************
+ * The sums are taken out under the lock and written without it,
+ * increments added meanwhile go to the next flush.
+ * The sums of failed upserts are reported by signalFlushFailed() and kept for the next flush.
+****************************************************************************************/
+bool
+CounterAggregator::flush()
+{
+QHash<QString, QHash<QByteArray, Counters>> spaces;
+QHash<QString, QVariantList> insertTuples;
+
+	Timer.stop();
+
+	Mutex.lock();
+	spaces.swap(Spaces);
+	insertTuples =InsertTuples;
+	Keys =0;
+	bRequested =false;
+	Mutex.unlock();
+
+bool result =true;
+
+	for(auto s =spaces.cbegin(); s != spaces.cend(); ++s)
+	{
+	Layout format;
+
+		if(!layout(s.key(), format))
+		{
+			emit signalFlushFailed(s.key(), s.value().size(), tnt->getLastError());
+			restore(s.key(), s.value());
+			result =false;
+			continue;
+		}
+
+	const QVariantList insertTuple =insertTuples.value(s.key());
+	QList<QVariantList> tuples, actions;
+	QList<QByteArray> keys; // in the order of tuples
+	QList<int> failed;
+
+		for(auto c =s.value().cbegin(); c != s.value().cend(); ++c)
+		{
+		QVariantList tuple =format.Tuple;
+		QVariantList ops;
+
+			for(int f =0; f < insertTuple.size(); f++)
+				put(tuple, f + 1, insertTuple[f]);
+
+			for(int k =0; k < format.KeyFields.size() && k < c->Key.size(); k++)
+				put(tuple, format.KeyFields[k], c->Key[k]);
+
+			for(auto f =c->Fields.cbegin(); f != c->Fields.cend(); ++f)
+			{
+				put(tuple, f.key(), f.value().value());
+				ops.append(QVariant(List {"+", f.key(), f.value().value()}));
+			}
+
+			keys.append(c.key());
+			tuples.append(tuple);
+			actions.append(ops);
+		}
+
+		if(tnt->upsertData(s.key(), tuples, actions, &failed))
+			emit signalFlushed(s.key(), tuples.size());
+		else
+		{
+		QHash<QByteArray, Counters> rest;
+
+			for(const int c : failed)
+				rest.insert(keys[c], s.value()[keys[c]]);
+
+			emit signalFlushFailed(s.key(), rest.size(), tnt->getLastError());
+			restore(s.key(), rest);
+			result =false;
+		}
+	}
+
+return(result);
+}
+
+void
+CounterAggregator::setStaleness(const int staleness)
+{
+	Staleness =qMax(staleness, 0);
+}
+
+void
+CounterAggregator::setMaxKeys(const int maxKeys)
+{
+QMutexLocker lock(&Mutex);
+
+	MaxKeys =qMax(maxKeys, 1);
+}
+
+int
+CounterAggregator::keys()
+{
+QMutexLocker lock(&Mutex);
+
+return(Keys);
+}
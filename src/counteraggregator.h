@@ -0,0 +1,100 @@
+#pragma once
+/******************************************************************
+ * QTNT::CounterAggregator - client-side sums of counter increments
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+ * license: GPLv3 2007 - https://www.gnu.org/licenses/gpl-3.0.html
+******************************************************************/
+#include <QMutex>
+#include "qtarantool.h"
+
+namespace QTNT
+{
+/************************************************************************************************
+ * Sums increments per (space, primary key, field) in memory and writes them as one
+ * IPROTO_UPSERT per key: {'+', field, sum} for every changed field of the key.
+ * A key that does not exist yet is inserted with the key and the counters at their fields,
+ * the other fields are taken from setInsertTuple() or by the type of the format field:
+ * 0 for numbers, false, empty string/varbinary, null for nullable (other types need setInsertTuple()).
+ * The sums are written not later than 'staleness' ms after the first increment
+ * (or when 'maxKeys' keys are collected). The sums of failed upserts are kept for the next flush.
+ * add() can be called from any thread.
+ *
+ *	CounterAggregator hits(&tnt, 500);
+ *
+ *		hits.add("Hits", {url}, 2);			// field 2 +1
+ *		hits.add("Hits", {url}, 3, bytes);	// field 3 +bytes
+ *		hits.addReal("Hits", {url}, 4, ms);	// field 4 +ms
+************************************************************************************************/
+class CounterAggregator : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit CounterAggregator(QTarantool *tnt, const int staleness =1000, QObject *parent =nullptr); // 'tnt' must outlive the aggregator
+	~CounterAggregator() { flush(); }
+
+	void
+	add(const QString &spaceName, const IndexKey &key, const int field, const qint64 delta =1);
+	void
+	addReal(const QString &spaceName, const IndexKey &key, const int field, const double delta); // the sum is written as double
+	void
+	setInsertTuple(const QString &spaceName, const QVariantList &tuple); // fields of a new tuple (the key and the counters are set over it)
+	bool
+	flush(); // writes all sums now (from the thread of the aggregator), 'false' - some upsert failed
+	void
+	setStaleness(const int staleness); // ms
+	void
+	setMaxKeys(const int maxKeys =100000); // of all spaces
+	int
+	keys(); // keys waiting for flush
+
+private:
+	struct Sum
+	{
+		qint64 Int =0;
+		double Real =0;
+		bool bReal =false;
+
+		inline QVariant
+		value() const { return(bReal ? QVariant(Real + Int) : QVariant(Int)); }
+	};
+
+	struct Counters
+	{
+		QVariantList Key;
+		QMap<int, Sum> Fields; // field (from 1) : sum
+	};
+
+	struct Layout
+	{
+		QVariantList Tuple; // defaults of the format fields
+		QList<int> KeyFields; // of the primary key, from 1
+	};
+
+	QTarantool *tnt;
+	QMutex Mutex; // guards Spaces, InsertTuples and Keys
+	QHash<QString, QHash<QByteArray, Counters>> Spaces; // space : encoded key : counters
+	QHash<QString, QVariantList> InsertTuples; // space : tuple of setInsertTuple()
+	QHash<QString, Layout> Layouts; // space : layout, the thread of the aggregator only
+	QTimer Timer;
+	int Keys =0;
+	int MaxKeys =100000;
+	int Staleness;
+	bool bRequested =false; // flush is queued
+
+	Sum &
+	sum(const QString &spaceName, const IndexKey &key, const int field);
+	void
+	keyAdded();
+	bool
+	layout(const QString &spaceName, Layout &layout);
+	void
+	restore(const QString &spaceName, const QHash<QByteArray, Counters> &counters);
+
+signals:
+	void signalFlushed(const QString &spaceName, const int keys);
+	void signalFlushFailed(const QString &spaceName, const int keys, const ERROR &msg);
+};
+
+}
@@ -3,6 +3,7 @@
  * origin-src: https://github.com/romixlab/qmsgpack
 *********************************************************************/
 #include "msgpack.h"
+#include "msgpackbufferpool.h"
 #include "private/unpack_p.h"
 #include "private/pack_p.h"
 
@@ -25,14 +26,18 @@ const quint8 *end = p + data.size() - 1;
 	return MsgPackPrivate::unpack(p, end);
 }
 
+namespace {
+
 QByteArray
-MsgPack::pack(const QVariant &variant)
+pack_variant(const QVariant &variant, const bool bPooled)
 {
 QVector<QByteArray> user_data;
     // first run, calculate size
 size_t size = MsgPackPrivate::pack(variant, nullptr, false, user_data) - static_cast<quint8 *>(nullptr);
 
-QByteArray arr(size, Qt::Uninitialized); //arr.resize(size);
+QByteArray arr =(bPooled ? MsgPack::BufferPool::acquire(size) : QByteArray());
+
+	arr.resize(size);
 
     // second run, pack it
 	MsgPackPrivate::pack(variant, reinterpret_cast<quint8 *>(arr.data()), true, user_data);
@@ -40,6 +45,20 @@ QByteArray arr(size, Qt::Uninitialized); //arr.resize(size);
 return(arr);
 }
 
+} // namespace
+// exact size: the result can be kept long (keys, cached tuples)
+QByteArray
+MsgPack::pack(const QVariant &variant)
+{
+	return(pack_variant(variant, false));
+}
+
+QByteArray
+MsgPack::packPooled(const QVariant &variant)
+{
+	return(pack_variant(variant, true));
+}
+
 bool MsgPack::registerPacker(int qType, qint8 msgpackType, MsgPack::pack_user_f packer)
 {
     return MsgPackPrivate::register_packer(qType, msgpackType, packer);
@@ -112,3 +131,13 @@ void MsgPack::setCompatibilityModeEnabled(bool enabled)
 {
     MsgPackPrivate::compatibilityMode = enabled;
 }
+
+void MsgPack::setParallelThreshold(quint32 items)
+{
+    MsgPackPrivate::parallel_threshold = items;
+}
+
+quint32 MsgPack::parallelThreshold()
+{
+    return MsgPackPrivate::parallel_threshold;
+}
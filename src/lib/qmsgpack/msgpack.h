@@ -15,10 +15,16 @@ namespace MsgPack
     MSGPACK_EXPORT QVariant unpack(const QByteArray &data);
     MSGPACK_EXPORT bool registerUnpacker(qint8 msgpackType, unpack_user_f unpacker);
     MSGPACK_EXPORT QByteArray pack(const QVariant &variant);
+    // same as pack(), the buffer is taken from MsgPack::BufferPool (capacity rounded up to its bin):
+    // for transient data given back by BufferPool::release()
+    MSGPACK_EXPORT QByteArray packPooled(const QVariant &variant);
     MSGPACK_EXPORT bool registerPacker(int qType, qint8 msgpackType, pack_user_f packer);
     MSGPACK_EXPORT qint8 msgpackType(int qType);
     MSGPACK_EXPORT bool registerType(QMetaType::Type qType, quint8 msgpackType);
     MSGPACK_EXPORT void setCompatibilityModeEnabled(bool enabled);
+    // unpack() decodes arrays of 'items' and more in parallel on QThreadPool::globalInstance(), 0 - disabled (default)
+    MSGPACK_EXPORT void setParallelThreshold(quint32 items);
+    MSGPACK_EXPORT quint32 parallelThreshold();
 
 	template<class T>
 	MSGPACK_EXPORT QByteArray pack(const T &variant) { return(pack(QVariant::fromValue(variant))); };
@@ -0,0 +1,160 @@
+/*********************************************************************
+ * MsgPack::BufferPool - per-thread pool of recycled byte buffers
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+*********************************************************************/
+#include "msgpackbufferpool.h"
+
+#include <QVector>
+#include <atomic>
+
+using namespace MsgPack;
+
+namespace {
+
+const int MIN_SHIFT =8;		// 256 B
+const int MAX_SHIFT =24;	// 16 MB
+const int BINS =MAX_SHIFT - MIN_SHIFT + 1;
+
+// shared by the thread pools: set from any thread
+std::atomic<qint64> pool_capacity {8 * 1024 * 1024}; // per thread
+std::atomic<BufferPool::allocate_f> allocate_hook {nullptr};
+std::atomic<BufferPool::discard_f> discard_hook {nullptr};
+
+struct Pool
+{
+	QVector<QByteArray> bins[BINS];
+	BufferPool::Stats stats;
+};
+
+thread_local Pool pool;
+// the smallest bin with buffers of 'size' bytes and more
+inline int
+bin_up(const int size)
+{
+int shift =MIN_SHIFT;
+
+	while(shift <= MAX_SHIFT && (1 << shift) < size)
+		shift++;
+
+return(shift - MIN_SHIFT);
+}
+// the largest bin whose size fits into 'capacity'
+inline int
+bin_down(const int capacity)
+{
+int shift =MIN_SHIFT;
+
+	while(shift < MAX_SHIFT && (1 << (shift + 1)) <= capacity)
+		shift++;
+
+return(shift - MIN_SHIFT);
+}
+
+inline void
+drop(QByteArray &buffer)
+{
+	pool.stats.Dropped++;
+
+const BufferPool::discard_f discard =discard_hook.load(std::memory_order_relaxed);
+
+	if(discard)
+		discard(buffer);
+}
+
+} // namespace
+
+QByteArray
+BufferPool::acquire(const int size)
+{
+const int bin =bin_up(size);
+
+	if(bin < BINS && pool.bins[bin].size())
+	{
+	QByteArray buffer =pool.bins[bin].takeLast();
+
+		pool.stats.Hits++;
+		pool.stats.Buffers--;
+		pool.stats.Bytes -=buffer.capacity();
+
+	return(buffer);
+	}
+
+	pool.stats.Misses++;
+
+const int capacity =(bin < BINS ? 1 << (bin + MIN_SHIFT) : size); // pooled sizes are rounded up to the bin
+const allocate_f allocate =allocate_hook.load(std::memory_order_relaxed);
+
+	if(allocate)
+		return(allocate(capacity));
+
+QByteArray buffer;
+
+	buffer.reserve(capacity);
+
+return(buffer);
+}
+/****************************************************************************************
+ * QByteArray keeps its memory on resize(0) only if the capacity was reserved,
+ * so the capacity is reserved before truncating.
+****************************************************************************************/
+void
+BufferPool::release(QByteArray &&buffer)
+{
+	if(buffer.isNull())
+		return;
+
+const int capacity =buffer.capacity();
+
+	if(!buffer.isDetached() || capacity < (1 << MIN_SHIFT) || capacity > (2 << MAX_SHIFT) - 1
+	   || pool.stats.Bytes + capacity > pool_capacity.load(std::memory_order_relaxed))
+	{
+		drop(buffer);
+		buffer =QByteArray();
+
+	return;
+	}
+
+	buffer.reserve(capacity);
+	buffer.resize(0);
+	pool.bins[bin_down(capacity)].append(std::move(buffer));
+	buffer =QByteArray();
+
+	pool.stats.Released++;
+	pool.stats.Buffers++;
+	pool.stats.Bytes +=capacity;
+}
+
+void
+BufferPool::setCapacity(const qint64 bytes)
+{
+	pool_capacity =qMax(bytes, qint64(0));
+}
+
+qint64
+BufferPool::capacity()
+{
+	return(pool_capacity.load());
+}
+
+void
+BufferPool::setHooks(allocate_f allocate, discard_f discard)
+{
+	allocate_hook =allocate;
+	discard_hook =discard;
+}
+
+BufferPool::Stats
+BufferPool::stats()
+{
+	return(pool.stats);
+}
+
+void
+BufferPool::clear()
+{
+	for(auto &bin : pool.bins)
+		bin.clear();
+
+	pool.stats =Stats();
+}
@@ -0,0 +1,59 @@
+/*********************************************************************
+ * MsgPack::BufferPool - per-thread pool of recycled byte buffers
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+*********************************************************************/
+#ifndef MSGPACK_BUFFERPOOL_H
+#define MSGPACK_BUFFERPOOL_H
+
+#include <QByteArray>
+#include "msgpack_export.h"
+
+namespace MsgPack
+{
+/************************************************************************************************
+ * Buffers are kept in size-class bins (powers of 2, 256 B .. 16 MB) of the calling thread,
+ * no locks are taken. acquire() returns an empty buffer with enough capacity,
+ * release() gives the buffer back if nobody else shares it and the cap of the thread pool allows.
+ * MsgPack::packPooled() and QTarantool requests/replies draw their buffers from the pool,
+ * MsgPack::pack() does not: its results may live long and would keep the rounded capacity.
+************************************************************************************************/
+class MSGPACK_EXPORT BufferPool
+{
+public:
+	struct Stats
+	{
+		quint64 Hits =0;		// acquire() served from the pool
+		quint64 Misses =0;		// acquire() allocated a new buffer
+		quint64 Released =0;	// buffers taken back
+		quint64 Dropped =0;		// buffers not taken back: shared, too big or over the cap
+		int Buffers =0;			// buffers in the pool now
+		qint64 Bytes =0;		// capacity of buffers in the pool now
+
+		double
+		hitRate() const { return(Hits + Misses ? double(Hits) / (Hits + Misses) : 0); }
+	};
+
+	typedef QByteArray (*allocate_f)(int capacity); // must return a buffer with capacity() >= 'capacity'
+	typedef void (*discard_f)(QByteArray &buffer); // called for a buffer dropped by the pool
+
+	static QByteArray
+	acquire(const int size); // empty buffer with capacity() >= size
+	static void
+	release(QByteArray &&buffer);
+
+	static void
+	setCapacity(const qint64 bytes); // cap of every thread pool, 0 - pooling is disabled (default 8 MB)
+	static qint64
+	capacity();
+	static void
+	setHooks(allocate_f allocate, discard_f discard); // nullptr - default (QByteArray::reserve / none), set before the pools are in use: the pair is not swapped at once
+	static Stats
+	stats(); // of the calling thread
+	static void
+	clear(); // frees buffers of the calling thread, counters are reset
+};
+
+} // MsgPack
+
+#endif // MSGPACK_BUFFERPOOL_H
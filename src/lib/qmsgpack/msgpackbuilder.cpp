@@ -0,0 +1,317 @@
+/*********************************************************************
+ * MsgPack::Builder - typed writer of msgpack values (without QVariant)
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+*********************************************************************/
+#include "msgpackbuilder.h"
+#include "msgpack.h"
+#include "endianhelper.h"
+#include "private/pack_p.h"
+
+using namespace MsgPack;
+
+namespace {
+
+quint8 *
+string_header(const quint32 len, quint8 *p)
+{
+	if(len <= 31)
+		*p++ =FirstByte::FIXSTR | len;
+	else
+	if(len <= 0xff && !MsgPackPrivate::compatibilityMode)
+	{
+		*p++ =FirstByte::STR8;
+		*p++ =static_cast<quint8>(len);
+	}
+	else
+	if(len <= 0xffff)
+	{
+		*p++ =FirstByte::STR16;
+		_msgpack_store16(p, len);
+		p +=2;
+	}
+	else
+	{
+		*p++ =FirstByte::STR32;
+		_msgpack_store32(p, len);
+		p +=4;
+	}
+
+return(p);
+}
+
+} // namespace
+
+Builder &
+Builder::begin(const bool isMap)
+{
+	item();
+	frames.append({out.size(), 0, isMap});
+	out.append(5, '\0');
+
+return(*this);
+}
+/****************************************************************************************
+ * Closes the last open container: writes its header into the reserved place
+ * and removes the unused bytes.
+****************************************************************************************/
+Builder &
+Builder::end()
+{
+	if(frames.isEmpty())
+		return(*this);
+
+const Frame f =frames.last();
+const quint32 count =(f.isMap ? f.count / 2 : f.count);
+quint8 *hdr =reinterpret_cast<quint8 *>(out.data()) + f.pos;
+int size =5;
+
+	frames.removeLast();
+
+	if(count <= 15)
+	{
+		*hdr =(f.isMap ? FirstByte::FIXMAP : FirstByte::FIXARRAY) | count;
+		size =1;
+	}
+	else
+	if(count <= 0xffff)
+	{
+		*hdr =(f.isMap ? FirstByte::MAP16 : FirstByte::ARRAY16);
+		_msgpack_store16(hdr + 1, count);
+		size =3;
+	}
+	else
+	{
+		*hdr =(f.isMap ? FirstByte::MAP32 : FirstByte::ARRAY32);
+		_msgpack_store32(hdr + 1, count);
+	}
+
+	if(size < 5)
+		out.remove(f.pos + size, 5 - size);
+
+return(*this);
+}
+
+Packed
+Builder::build()
+{
+	while(frames.size())
+		end();
+
+Packed p;
+
+	p.Data =std::move(out);
+	out =QByteArray();
+
+return(p);
+}
+
+Builder &
+Builder::addNull()
+{
+	item();
+	out +=static_cast<char>(FirstByte::NIL);
+
+return(*this);
+}
+
+Builder &
+Builder::add(const bool v)
+{
+	item();
+	out +=static_cast<char>(v ? FirstByte::MTRUE : FirstByte::MFALSE);
+
+return(*this);
+}
+
+Builder &
+Builder::add(const qint64 v)
+{
+	return(write(MsgPackPrivate::pack_longlong, v));
+}
+
+Builder &
+Builder::add(const quint64 v)
+{
+	return(write(MsgPackPrivate::pack_ulonglong, v));
+}
+
+Builder &
+Builder::add(const double v)
+{
+	return(write(MsgPackPrivate::pack_double, v));
+}
+
+Builder &
+Builder::add(const float v)
+{
+	return(write(MsgPackPrivate::pack_float, v));
+}
+
+Builder &
+Builder::add(const char *utf8)
+{
+	return(add(utf8, utf8 ? static_cast<int>(strlen(utf8)) : 0));
+}
+
+Builder &
+Builder::add(const char *utf8, const int len)
+{
+const int pos =out.size();
+
+	item();
+	out.resize(pos + len + 5);
+
+quint8 *dst =reinterpret_cast<quint8 *>(out.data()) + pos;
+
+	out.resize(static_cast<int>(MsgPackPrivate::pack_string_raw(utf8, len, dst, true) - dst) + pos);
+
+return(*this);
+}
+/****************************************************************************************
+ * UTF-16 -> UTF-8 straight into the buffer (QString::toUtf8() would allocate a temporary).
+ * The first pass counts the exact length for the header.
+****************************************************************************************/
+Builder &
+Builder::add(const QString &v)
+{
+const ushort *s =v.utf16();
+const int n =v.size();
+quint32 len =0;
+
+	for(int c =0; c < n; c++)
+		if(s[c] < 0x80)
+			len +=1;
+		else
+		if(s[c] < 0x800)
+			len +=2;
+		else
+		if(QChar::isHighSurrogate(s[c]) && c + 1 < n && QChar::isLowSurrogate(s[c + 1]))
+		{
+			len +=4;
+			c++;
+		}
+		else
+			len +=3; // lone surrogate is written as is
+
+const int pos =out.size();
+
+	item();
+	out.resize(pos + len + 5);
+
+quint8 *p =reinterpret_cast<quint8 *>(out.data()) + pos;
+
+	p =string_header(len, p);
+
+	for(int c =0; c < n; c++)
+	{
+	uint ch =s[c];
+
+		if(ch < 0x80)
+			*p++ =static_cast<quint8>(ch);
+		else
+		if(ch < 0x800)
+		{
+			*p++ =static_cast<quint8>(0xc0 | (ch >> 6));
+			*p++ =static_cast<quint8>(0x80 | (ch & 0x3f));
+		}
+		else
+		if(QChar::isHighSurrogate(ch) && c + 1 < n && QChar::isLowSurrogate(s[c + 1]))
+		{
+			ch =QChar::surrogateToUcs4(static_cast<ushort>(ch), s[++c]);
+			*p++ =static_cast<quint8>(0xf0 | (ch >> 18));
+			*p++ =static_cast<quint8>(0x80 | ((ch >> 12) & 0x3f));
+			*p++ =static_cast<quint8>(0x80 | ((ch >> 6) & 0x3f));
+			*p++ =static_cast<quint8>(0x80 | (ch & 0x3f));
+		}
+		else
+		{
+			*p++ =static_cast<quint8>(0xe0 | (ch >> 12));
+			*p++ =static_cast<quint8>(0x80 | ((ch >> 6) & 0x3f));
+			*p++ =static_cast<quint8>(0x80 | (ch & 0x3f));
+		}
+	}
+
+	out.resize(static_cast<int>(p - reinterpret_cast<quint8 *>(out.data())));
+
+return(*this);
+}
+
+Builder &
+Builder::add(const QByteArray &v)
+{
+const int pos =out.size();
+
+	item();
+	out.resize(pos + 5);
+
+quint8 *dst =reinterpret_cast<quint8 *>(out.data()) + pos;
+
+	out.resize(static_cast<int>(MsgPackPrivate::pack_bin_header(v.size(), dst, true) - dst) + pos);
+	out +=v;
+
+return(*this);
+}
+
+Builder &
+Builder::add(const Packed &v)
+{
+	item();
+	out +=v.Data;
+
+return(*this);
+}
+
+/****************************************************************************************
+ * The usual field types are written in place, the others by MsgPack::pack().
+****************************************************************************************/
+Builder &
+Builder::add(const QVariant &v)
+{
+	switch(static_cast<int>(v.type()))
+	{
+	case QMetaType::Bool:
+		return(add(v.toBool()));
+	case QMetaType::Int:
+	case QMetaType::LongLong:
+		return(add(static_cast<qint64>(v.toLongLong())));
+	case QMetaType::UInt:
+	case QMetaType::ULongLong:
+		return(add(static_cast<quint64>(v.toULongLong())));
+	case QMetaType::Double:
+		return(add(v.toDouble()));
+	case QMetaType::Float:
+		return(add(v.toFloat()));
+	case QMetaType::QString:
+		return(add(v.toString()));
+	case QMetaType::QByteArray:
+		return(add(v.toByteArray()));
+	case QMetaType::QVariantList:
+		beginArray();
+
+		for(const auto &value : v.toList())
+			add(value);
+
+		return(end());
+	}
+
+	item();
+	out +=MsgPack::pack(v);
+
+return(*this);
+}
+/****************************************************************************************
+ * Appends the tuple as the next item of the batch.
+****************************************************************************************/
+TupleBatch &
+TupleBatch::append(TupleBuilder &&tuple)
+{
+	while(tuple.level())
+		tuple.end();
+
+	item();
+	out +=tuple.data();
+	tuple.clear();
+
+return(*this);
+}
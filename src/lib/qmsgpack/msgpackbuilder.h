@@ -0,0 +1,164 @@
+/*********************************************************************
+ * MsgPack::Builder - typed writer of msgpack values (without QVariant)
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+*********************************************************************/
+#ifndef MSGPACK_BUILDER_H
+#define MSGPACK_BUILDER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVariant>
+#include <QVarLengthArray>
+#include "msgpack_export.h"
+#include "msgpackcommon.h"
+
+namespace MsgPack
+{
+/************************************************************************************************
+ * Appends typed values straight into one msgpack buffer, no QVariant is created.
+ * The quantity of items of array/map is not needed in advance: the header is reserved
+ * with the max size and shrinked by end().
+ * The result is taken by build() without copy (the builder is left empty),
+ * the data methods of QTarantool take the builder by rvalue:
+ *
+ *	tnt.insertBuilt("Tester", MsgPack::TupleBuilder() << 1 << "hello" << true);
+************************************************************************************************/
+class MSGPACK_EXPORT Builder
+{
+public:
+	explicit Builder(const int reserve =256) { out.reserve(reserve); }
+
+	Builder &
+	beginArray() { return(begin(false)); }
+	Builder &
+	beginMap() { return(begin(true)); } // keys and values are added in turn
+	Builder &
+	end();
+
+	Builder &
+	addNull();
+	Builder &
+	add(const bool v);
+	Builder &
+	add(const int v) { return(add(static_cast<qint64>(v))); }
+	Builder &
+	add(const uint v) { return(add(static_cast<quint64>(v))); }
+	Builder &
+	add(const long v) { return(add(static_cast<qint64>(v))); }
+	Builder &
+	add(const ulong v) { return(add(static_cast<quint64>(v))); }
+	Builder &
+	add(const qint64 v);
+	Builder &
+	add(const quint64 v);
+	Builder &
+	add(const double v);
+	Builder &
+	add(const float v);
+	Builder &
+	add(const char *utf8); // string
+	Builder &
+	add(const char *utf8, const int len);
+	Builder &
+	add(const QString &v); // string, encoded to UTF-8 in place
+	Builder &
+	add(const QByteArray &v); // binary
+	Builder &
+	add(const Packed &v); // already encoded value, copied as is
+	Builder &
+	add(const QVariant &v); // scalars, strings and lists in place, other types by MsgPack::pack()
+
+	template<typename T>
+	Builder &
+	operator<<(const T &v) & { return(add(v)); }
+	template<typename T>
+	Builder &&
+	operator<<(const T &v) && { return(std::move(add(v))); } // keeps a temporary builder an rvalue
+
+	inline int
+	level() const { return(frames.size()); } // quantity of open containers
+	inline const QByteArray &
+	data() const { return(out); } // valid when all containers are closed
+	Packed
+	build(); // closes open containers and takes the buffer
+	void
+	clear() { out.clear(); frames.clear(); }
+
+protected:
+	struct Frame
+	{
+		int pos;		// position of the reserved header
+		quint32 count;	// items added
+		bool isMap;
+	};
+
+	QByteArray out;
+	QVarLengthArray<Frame, 8> frames;
+
+	Builder &
+	begin(const bool isMap);
+	inline void
+	item() { if(frames.size()) frames.last().count++; }
+
+	template<typename F, typename T>
+	inline Builder &
+	write(F packer, const T v)
+	{
+	quint8 buf[9];
+
+		item();
+		out.append(reinterpret_cast<const char *>(buf), static_cast<int>(packer(v, buf, true) - buf));
+
+	return(*this);
+	}
+};
+/************************************************************************************************
+ * One tuple: the array is opened by the constructor.
+************************************************************************************************/
+class MSGPACK_EXPORT TupleBuilder : public Builder
+{
+public:
+	explicit TupleBuilder(const int reserve =64) : Builder(reserve) { beginArray(); }
+
+	template<typename T>
+	TupleBuilder &
+	operator<<(const T &v) & { add(v); return(*this); }
+	template<typename T>
+	TupleBuilder &&
+	operator<<(const T &v) && { add(v); return(std::move(*this)); } // the type is kept for the overloads taking TupleBuilder &&
+};
+/************************************************************************************************
+ * Array of tuples, e.g. for QTarantool::setBuilt(space, TupleBatch &&).
+ * Fields can be written in place (beginTuple() << 1 << "a"; endTuple();) or whole tuples appended.
+************************************************************************************************/
+class MSGPACK_EXPORT TupleBatch : public Builder
+{
+public:
+	explicit TupleBatch(const int reserve =64 * 1024) : Builder(reserve) { beginArray(); }
+
+	Builder &
+	beginTuple() { return(beginArray()); }
+	Builder &
+	endTuple() { return(end()); }
+	TupleBatch &
+	append(TupleBuilder &&tuple);
+
+	template<typename T>
+	TupleBatch &
+	operator<<(const T &v) & { add(v); return(*this); }
+	template<typename T>
+	TupleBatch &&
+	operator<<(const T &v) && { add(v); return(std::move(*this)); } // a temporary batch is not taken for a single tuple
+	TupleBatch &
+	operator<<(TupleBuilder &&tuple) & { return(append(std::move(tuple))); }
+	TupleBatch &&
+	operator<<(TupleBuilder &&tuple) && { append(std::move(tuple)); return(std::move(*this)); }
+
+	inline int
+	count() const { return(frames.size() ? frames.first().count : 0); } // tuples added
+};
+
+} // MsgPack
+
+#endif // MSGPACK_BUILDER_H
@@ -0,0 +1,311 @@
+/*********************************************************************
+ * MsgPack::Columns - column-oriented (struct of arrays) decoder of tuples
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+*********************************************************************/
+#include "msgpackcolumns.h"
+#include "endianhelper.h"
+#include "private/unpack_p.h"
+
+using namespace MsgPack;
+
+void
+Columns::setFormat(const QVector<Type> &types, const QStringList &names)
+{
+	columns.clear();
+	columns.resize(types.size());
+
+	for(int c =0; c < types.size(); c++)
+	{
+		columns[c].DataType =types[c];
+		columns[c].Name =(c < names.size() ? names[c] : QString());
+	}
+
+	clear();
+}
+/****************************************************************************************
+ * Tarantool field types: https://www.tarantool.io/en/doc/latest/concepts/data_model/indexes/
+****************************************************************************************/
+Columns::Type
+Columns::fieldType(const QString &type)
+{
+	if(type == "unsigned" || type == "integer" || type == "boolean")
+		return(Integer);
+
+	if(type == "number" || type == "double")
+		return(Double);
+
+	if(type == "string" || type == "varbinary")
+		return(String);
+
+return(Variant);
+}
+
+void
+Columns::clear()
+{
+	for(auto &col : columns)
+	{
+		col.Integers.clear();
+		col.Doubles.clear();
+		col.Text.clear();
+		col.Variants.clear();
+		col.Nulls.clear();
+		col.Offsets.clear();
+
+		if(col.DataType == String)
+			col.Offsets.append(0);
+	}
+
+	rowCount =0;
+}
+
+int
+Columns::indexOf(const QString &name) const
+{
+	for(int c =0; c < columns.size(); c++)
+		if(columns[c].Name == name)
+			return(c);
+
+return(-1);
+}
+/****************************************************************************************
+ * Appends rows from the msgpack array of tuples located at 'offset' of 'data'.
+ * Return: false on malformed data (all rows are removed).
+****************************************************************************************/
+bool
+Columns::decode(const QByteArray &data, const int offset)
+{
+	if(offset < 0 || offset >= data.size())
+		return(false);
+
+quint8 *p =reinterpret_cast<quint8 *>(const_cast<char *>(data.constData())) + offset;
+const quint8 *end =reinterpret_cast<const quint8 *>(data.constData()) + data.size();
+quint32 tuples =0;
+bool isMap =false;
+
+	p =MsgPackPrivate::unpack_container_len(p, end, tuples, isMap);
+
+	if(!p || isMap || static_cast<quint64>(end - p) < tuples) // every tuple takes at least 1 byte
+		return(false);
+
+	for(auto &col : columns)
+	{
+		switch(col.DataType)
+		{
+		case Integer:
+			col.Integers.reserve(rowCount + tuples);
+			break;
+		case Double:
+			col.Doubles.reserve(rowCount + tuples);
+			break;
+		case String:
+			col.Offsets.reserve(rowCount + tuples + 1);
+			break;
+		default:
+			col.Variants.reserve(rowCount + tuples);
+		}
+
+		col.Nulls.resize(rowCount + tuples);
+	}
+
+	for(quint32 t =0; t < tuples && p; t++, rowCount++)
+	{
+	quint32 fields =0;
+
+		p =MsgPackPrivate::unpack_container_len(p, end, fields, isMap);
+
+		if(!p || isMap)
+		{
+			p =nullptr;
+			break;
+		}
+
+		for(int c =0; c < columns.size() && p; c++)
+			if(static_cast<quint32>(c) < fields)
+				p =decode_field(columns[c], p, end);
+			else
+				append_null(columns[c]);
+
+		for(quint32 c =columns.size(); c < fields && p; c++) // fields beyond the format
+			p =MsgPackPrivate::skip(p, end);
+	}
+
+	if(!p)
+	{
+		clear();
+
+	return(false);
+	}
+
+return(true);
+}
+/****************************************************************************************
+ * Decodes one field of the current row (rowCount) into the column.
+ * Return: pointer to the next value or nullptr on truncated data.
+****************************************************************************************/
+quint8 *
+Columns::decode_field(Column &col, quint8 *p, const quint8 *end)
+{
+	if(p >= end)
+		return(nullptr);
+
+	if(col.DataType == Variant)
+	{
+	quint8 *next =MsgPackPrivate::skip(p, end); // bounds check before unchecked unpack
+	QVariant v;
+
+		if(!next)
+			return(nullptr);
+
+		if(*p == FirstByte::NIL)
+			col.Nulls.setBit(rowCount);
+		else
+			MsgPackPrivate::unpack_type(v, p);
+
+		col.Variants.append(v);
+
+	return(next);
+	}
+
+const quint8 code =*p;
+qint64 i =0;
+double d =0;
+bool isInteger =true;
+int size =0; // bytes of value after the format byte
+
+	if(code <= FirstByte::POSITIVE_FIXINT || code >= FirstByte::NEGATIVE_FIXINT)
+		i =static_cast<qint8>(code);
+	else
+	if(code == FirstByte::MFALSE || code == FirstByte::MTRUE)
+		i =(code == FirstByte::MTRUE);
+	else
+	if(code >= FirstByte::FLOAT32 && code <= FirstByte::INT64)
+	{
+		size =(code == FirstByte::FLOAT32 ? 4 : code == FirstByte::FLOAT64 ? 8 : 1 << ((code - FirstByte::UINT8) & 0x03));
+
+		if(end - p <= size)
+			return(nullptr);
+
+	quint8 *v =p + 1;
+	quint64 raw =(size == 1 ? *v :
+				  size == 2 ? _msgpack_load16(quint64, v) :
+				  size == 4 ? _msgpack_load32(quint64, v) : _msgpack_load64(quint64, v));
+
+		if(code == FirstByte::FLOAT32)
+		{
+		quint32 raw32 =static_cast<quint32>(raw);
+		float f;
+
+			memcpy(&f, &raw32, 4);
+			d =f;
+			isInteger =false;
+		}
+		else
+		if(code == FirstByte::FLOAT64)
+		{
+			memcpy(&d, &raw, 8);
+			isInteger =false;
+		}
+		else
+		if(code <= FirstByte::UINT64)
+			i =static_cast<qint64>(raw); // [!] uint64 > INT64_MAX wraps
+		else // sign extension of INT8 .. INT64
+			i =(size == 1 ? static_cast<qint8>(raw) :
+				size == 2 ? static_cast<qint16>(raw) :
+				size == 4 ? static_cast<qint32>(raw) : static_cast<qint64>(raw));
+	}
+	else
+	{ // nil, string, binary, array, map, ext
+	quint8 *next =MsgPackPrivate::skip(p, end);
+
+		if(!next)
+			return(nullptr);
+
+		if(col.DataType == String && code != FirstByte::NIL)
+		{
+		quint32 len =0;
+
+			if(code >= FirstByte::FIXSTR && code < FirstByte::NIL)
+				len =code & 0x1f;
+			else
+			if(code == FirstByte::STR8 || code == FirstByte::BIN8)
+				len =p[1];
+			else
+			if(code == FirstByte::STR16 || code == FirstByte::BIN16)
+				len =_msgpack_load16(quint32, p + 1);
+			else
+			if(code == FirstByte::STR32 || code == FirstByte::BIN32)
+				len =_msgpack_load32(quint32, p + 1);
+			else
+			{
+				append_null(col); // array/map/ext in the string column
+
+			return(next);
+			}
+
+			col.Text.append(reinterpret_cast<const char *>(next - len), len);
+			col.Offsets.append(col.Text.size());
+
+		return(next);
+		}
+
+		append_null(col);
+
+	return(next);
+	}
+
+	switch(col.DataType)
+	{
+	case Integer:
+		col.Integers.append(isInteger ? i : static_cast<qint64>(d));
+		break;
+	case Double:
+		col.Doubles.append(isInteger ? static_cast<double>(i) : d);
+		break;
+	default: // number in the string column
+		append_null(col);
+	}
+
+return(p + 1 + size);
+}
+
+void
+Columns::append_null(Column &col)
+{
+	switch(col.DataType)
+	{
+	case Integer:
+		col.Integers.append(0);
+		break;
+	case Double:
+		col.Doubles.append(0);
+		break;
+	case String:
+		col.Offsets.append(col.Text.size());
+		break;
+	default:
+		col.Variants.append(QVariant());
+	}
+
+	col.Nulls.setBit(rowCount);
+}
+
+QVariant
+Columns::Column::value(const int row) const
+{
+	if(row < 0 || row >= Nulls.size() || isNull(row))
+		return(QVariant());
+
+	switch(DataType)
+	{
+	case Integer:
+		return(Integers[row]);
+	case Double:
+		return(Doubles[row]);
+	case String:
+		return(string(row));
+	default:
+		return(Variants[row]);
+	}
+}
@@ -0,0 +1,94 @@
+/*********************************************************************
+ * MsgPack::Columns - column-oriented (struct of arrays) decoder of tuples
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+*********************************************************************/
+#ifndef MSGPACK_COLUMNS_H
+#define MSGPACK_COLUMNS_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QBitArray>
+#include <QStringList>
+#include <QVariant>
+#include "msgpack_export.h"
+#include "msgpackcommon.h"
+
+namespace MsgPack
+{
+/************************************************************************************************
+ * Decodes a msgpack array of tuples (arrays) directly into per-field typed vectors.
+ * The type of every column is set by the format (see fieldType()), fields beyond the format are skipped.
+ * Numbers are stored unboxed, strings are stored as one UTF-8 blob with an offsets table.
+ * Fields of types without a native column (array, map, ext...) are stored as QVariant.
+************************************************************************************************/
+class MSGPACK_EXPORT Columns
+{
+public:
+	enum Type : quint8 {
+
+		Variant =0,	// any value as QVariant
+		Integer,	// qint64
+		Double,		// double
+		String		// UTF-8 text (or binary)
+	};
+
+	struct MSGPACK_EXPORT Column
+	{
+		QString Name;
+		Type DataType =Variant;
+
+		QVector<qint64> Integers;
+		QVector<double> Doubles;
+		QVector<quint32> Offsets; // String: row N occupies Text[Offsets[N] .. Offsets[N + 1])
+		QByteArray Text;
+		QVariantList Variants;
+		QBitArray Nulls; // true - field is nil, absent in the tuple or of incompatible type
+
+		inline bool
+		isNull(const int row) const { return(Nulls.testBit(row)); }
+		inline QByteArray
+		bytes(const int row) const { return(QByteArray::fromRawData(Text.constData() + Offsets[row], Offsets[row + 1] - Offsets[row])); }
+		inline QString
+		string(const int row) const { return(QString::fromUtf8(Text.constData() + Offsets[row], Offsets[row + 1] - Offsets[row])); }
+		QVariant
+		value(const int row) const;
+	};
+
+	Columns() { }
+	Columns(const QVector<Type> &types, const QStringList &names ={}) { setFormat(types, names); }
+
+	void
+	setFormat(const QVector<Type> &types, const QStringList &names ={});
+	static Type
+	fieldType(const QString &type); // column type of the Tarantool space format type ('unsigned', 'string'...)
+
+	bool
+	decode(const QByteArray &data, const int offset =0); // array of tuples at 'offset', false - malformed data
+	void
+	clear(); // remove all rows, format is kept
+
+	inline int
+	rows() const { return(rowCount); }
+	inline int
+	count() const { return(columns.size()); }
+	inline const Column &
+	column(const int i) const { return(columns[i]); }
+	inline const Column &
+	operator[](const int i) const { return(columns[i]); }
+	int
+	indexOf(const QString &name) const;
+
+private:
+	QVector<Column> columns;
+	int rowCount =0;
+
+	quint8 *
+	decode_field(Column &col, quint8 *p, const quint8 *end);
+	void
+	append_null(Column &col);
+};
+
+} // MsgPack
+
+#endif // MSGPACK_COLUMNS_H
@@ -32,6 +32,19 @@ typedef QVariant (*unpack_user_f)(const QByteArray &data);
  * @return current version
  */
 MSGPACK_EXPORT QString version();
+/**
+ * @brief already encoded msgpack value
+ * Packed into the output as is, without re-encoding (see MsgPack::fromJson())
+ * Not an aggregate on purpose: '{...}' arguments must not be converted to Packed.
+ */
+struct Packed
+{
+	Packed() { }
+	static Packed
+	fromData(const QByteArray &data) { Packed p; p.Data =data; return(p); }
+
+	QByteArray Data;
+};
 /**
  * @brief The FirstByte enum
  * From Message Pack spec
@@ -77,4 +90,7 @@ const quint8 MAP32      = 0xdf;
 const quint8 NEGATIVE_FIXINT = 0xe0;
 }
 }
+
+Q_DECLARE_METATYPE(MsgPack::Packed)
+
 #endif // COMMON_H
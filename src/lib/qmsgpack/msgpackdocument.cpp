@@ -0,0 +1,563 @@
+/*********************************************************************
+ * MsgPack::Document - arena-backed read-only msgpack document
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+*********************************************************************/
+#include "msgpackdocument.h"
+#include "endianhelper.h"
+#include "private/unpack_p.h"
+
+using namespace MsgPack;
+
+namespace {
+
+const int MAX_DEPTH =1024; // nesting of arrays/maps, as msgpackjson: deeper data is malformed
+
+}
+
+bool
+Document::parse(const QByteArray &data)
+{
+	clear();
+	buffer =data; // shared, not copied
+
+quint8 *p =reinterpret_cast<quint8 *>(const_cast<char *>(buffer.constData()));
+const quint8 *end =p + buffer.size();
+
+	nodes.reserve(buffer.size() / 4 + 1); // each value takes at least 1 byte, the arena grows if needed
+
+	while(p && p < end)
+	{
+	const quint32 index =nodes.size();
+
+		roots.append(index);
+		nodes.resize(index + 1);
+		p =parse_node(p, end, index);
+	}
+
+	if(!p) // malformed or truncated data
+	{
+		clear();
+
+	return(false);
+	}
+
+return(true);
+}
+
+void
+Document::clear()
+{
+	buffer.clear();
+	nodes.clear();
+	roots.clear();
+}
+/****************************************************************************************
+ * Decodes one value at 'p' into the node 'index' (already allocated).
+ * Children of array/map are allocated as one block at the end of the arena.
+ * Return: pointer to the next value or nullptr on error (or nesting over MAX_DEPTH).
+****************************************************************************************/
+quint8 *
+Document::parse_node(quint8 *p, const quint8 *end, const quint32 index, const int depth)
+{
+	if(p >= end)
+		return(nullptr);
+
+const quint8 *base =reinterpret_cast<const quint8 *>(buffer.constData());
+Node n;
+quint32 len =0;
+int lenSize =0;	// size of the length field of str/bin/ext/array/map
+
+	memset(&n, 0, sizeof(n));
+	n.code =*p++;
+
+	if(n.code <= FirstByte::POSITIVE_FIXINT)
+	{
+		n.type =UInt;
+		n.u =n.code;
+	}
+	else
+	if(n.code >= FirstByte::NEGATIVE_FIXINT)
+	{
+		n.type =Int;
+		n.i =static_cast<qint8>(n.code);
+	}
+	else
+	if(n.code < FirstByte::FIXARRAY)
+	{
+		n.type =Map;
+		len =n.code & 0x0f;
+	}
+	else
+	if(n.code < FirstByte::FIXSTR)
+	{
+		n.type =Array;
+		len =n.code & 0x0f;
+	}
+	else
+	if(n.code < FirstByte::NIL)
+	{
+		n.type =String;
+		len =n.code & 0x1f;
+	}
+	else
+	{
+	int valueSize =0; // size of the fixed-width value
+
+		switch(n.code)
+		{
+		case FirstByte::NIL:
+		case FirstByte::NEVER_USED:
+			n.type =Nil;
+			break;
+		case FirstByte::MFALSE:
+		case FirstByte::MTRUE:
+			n.type =Bool;
+			n.b =(n.code == FirstByte::MTRUE);
+			break;
+		case FirstByte::BIN8:
+		case FirstByte::BIN16:
+		case FirstByte::BIN32:
+			n.type =Binary;
+			lenSize =1 << (n.code - FirstByte::BIN8);
+			break;
+		case FirstByte::STR8:
+		case FirstByte::STR16:
+		case FirstByte::STR32:
+			n.type =String;
+			lenSize =1 << (n.code - FirstByte::STR8);
+			break;
+		case FirstByte::EXT8:
+		case FirstByte::EXT16:
+		case FirstByte::EXT32:
+			n.type =Ext;
+			lenSize =1 << (n.code - FirstByte::EXT8);
+			break;
+		case FirstByte::FIXEXT1:
+		case FirstByte::FIXEXT2:
+		case FirstByte::FIXEXT4:
+		case FirstByte::FIXEXT8:
+		case FirstByte::FIXEX16:
+			n.type =Ext;
+			len =1 << (n.code - FirstByte::FIXEXT1);
+			break;
+		case FirstByte::ARRAY16:
+		case FirstByte::ARRAY32:
+			n.type =Array;
+			lenSize =(n.code == FirstByte::ARRAY16 ? 2 : 4);
+			break;
+		case FirstByte::MAP16:
+		case FirstByte::MAP32:
+			n.type =Map;
+			lenSize =(n.code == FirstByte::MAP16 ? 2 : 4);
+			break;
+		case FirstByte::FLOAT32:
+			n.type =Float;
+			valueSize =4;
+			break;
+		case FirstByte::FLOAT64:
+			n.type =Double;
+			valueSize =8;
+			break;
+		default: // [U]INT8 .. [U]INT64
+			n.type =(n.code <= FirstByte::UINT64 ? UInt : Int);
+			valueSize =1 << ((n.code - FirstByte::UINT8) & 0x03);
+		}
+
+		if(end - p < lenSize + valueSize)
+			return(nullptr);
+
+		switch(lenSize)
+		{
+		case 1:
+			len =*p;
+			break;
+		case 2:
+			len =_msgpack_load16(quint32, p);
+			break;
+		case 4:
+			len =_msgpack_load32(quint32, p);
+			break;
+		}
+
+		p +=lenSize;
+
+		if(valueSize)
+		{
+		quint64 raw =(valueSize == 1 ? *p :
+					  valueSize == 2 ? _msgpack_load16(quint64, p) :
+					  valueSize == 4 ? _msgpack_load32(quint64, p) : _msgpack_load64(quint64, p));
+
+			if(n.type == Float)
+			{
+			quint32 raw32 =static_cast<quint32>(raw);
+
+				memcpy(&n.f, &raw32, 4);
+			}
+			else
+			if(n.type == Double)
+				memcpy(&n.d, &raw, 8);
+			else
+			if(n.type == UInt)
+				n.u =raw;
+			else // sign extension of INT8 .. INT64
+				n.i =(valueSize == 1 ? static_cast<qint8>(raw) :
+					  valueSize == 2 ? static_cast<qint16>(raw) :
+					  valueSize == 4 ? static_cast<qint32>(raw) : static_cast<qint64>(raw));
+
+			p +=valueSize;
+		}
+	}
+
+	n.len =len;
+
+	if(n.type == Ext)
+	{
+		if(p >= end)
+			return(nullptr);
+
+		n.ext =static_cast<qint8>(*p++);
+	}
+
+	if(n.type == String || n.type == Binary || n.type == Ext)
+	{
+		if(static_cast<quint64>(end - p) < len)
+			return(nullptr);
+
+		n.offset =static_cast<quint32>(p - base);
+		nodes[index] =n;
+
+	return(p + len);
+	}
+
+	if(n.type == Array || n.type == Map)
+	{
+	quint64 count =(n.type == Map ? 2ULL * len : len);
+
+		if(depth >= MAX_DEPTH)
+			return(nullptr);
+
+		if(static_cast<quint64>(end - p) < count) // every item takes at least 1 byte
+			return(nullptr);
+
+		n.first =static_cast<quint32>(nodes.size());
+		nodes.resize(nodes.size() + static_cast<int>(count)); // one block for all children
+		nodes[index] =n;
+
+		for(quint32 c =0; c < count && p; c++)
+			p =parse_node(p, end, n.first + c, depth + 1);
+
+	return(p);
+	}
+
+	nodes[index] =n;
+
+return(p);
+}
+
+QVariant
+Document::toVariant() const
+{
+	if(roots.size() == 1)
+		return(node_variant(roots[0]));
+
+QVariantList list;
+
+	for(const auto &r : roots)
+		list.append(node_variant(r));
+
+return(list);
+}
+/****************************************************************************************
+ * Conversion of node to QVariant with the same types as MsgPackPrivate::unpack_xxx()
+****************************************************************************************/
+QVariant
+Document::node_variant(const quint32 index) const
+{
+const Node &n =nodes[index];
+const char *base =buffer.constData();
+
+	switch(n.type)
+	{
+	case Bool:
+		return(n.b);
+	case Int:
+		return(n.code == FirstByte::INT64 ? QVariant(n.i) : QVariant(static_cast<int>(n.i)));
+	case UInt:
+		return(n.code == FirstByte::UINT64 ? QVariant(n.u) : QVariant(static_cast<quint32>(n.u)));
+	case Float:
+		return(n.f);
+	case Double:
+		return(n.d);
+	case String:
+		return(QString::fromUtf8(base + n.offset, n.len));
+	case Binary:
+		return(QByteArray(base + n.offset, n.len));
+	case Array:
+	{
+	QVariantList list;
+
+		list.reserve(n.len);
+
+		for(quint32 c =0; c < n.len; c++)
+			list.append(node_variant(n.first + c));
+
+	return(list);
+	}
+	case Map:
+	{
+	QVariantMap str_map;
+	QUIntMap uint_map;
+
+		for(quint32 c =0; c < n.len; c++)
+		{
+		const Node &k =nodes[n.first + 2 * c];
+
+			if(k.type == String || str_map.size()) // see MsgPackPrivate::unpack_map_len()
+				str_map.insert(node_variant(n.first + 2 * c).toString(), node_variant(n.first + 2 * c + 1));
+			else
+				uint_map.insert(k.u, node_variant(n.first + 2 * c + 1));
+		}
+
+		if(str_map.size())
+		{
+			for(auto it =uint_map.cbegin(); it != uint_map.cend(); it++)
+				str_map[QString::number(it.key())] =it.value();
+
+		return(str_map);
+		}
+
+	return(QVariant::fromValue(uint_map));
+	}
+	case Ext:
+	{
+	QVariant v;
+
+		MsgPackPrivate::unpack_ext(v, reinterpret_cast<quint8 *>(const_cast<char *>(base)) + n.offset, n.ext, n.len);
+
+	return(v);
+	}
+	default:
+		return(QVariant());
+	}
+}
+/****************************************************************************************
+ *										Value
+****************************************************************************************/
+int
+Document::Value::size() const
+{
+const Node *n =node();
+
+return(n && n->type >= String ? static_cast<int>(n->len) : 0);
+}
+
+Document::Value
+Document::Value::at(const int i) const
+{
+const Node *n =node();
+
+	if(!n || i < 0 || static_cast<quint32>(i) >= n->len)
+		return(Value());
+
+	if(n->type == Array)
+		return(Value(doc, n->first + i));
+	else
+	if(n->type == Map)
+		return(Value(doc, n->first + 2 * i + 1));
+
+return(Value());
+}
+
+Document::Value
+Document::Value::key(const int i) const
+{
+const Node *n =node();
+
+	if(!n || n->type != Map || i < 0 || static_cast<quint32>(i) >= n->len)
+		return(Value());
+
+return(Value(doc, n->first + 2 * i));
+}
+
+Document::Value
+Document::Value::operator[](const qint64 n) const
+{
+const Node *node =this->node();
+
+	if(!node)
+		return(Value());
+
+	if(node->type == Array)
+		return(at(static_cast<int>(n)));
+
+	if(node->type == Map)
+		for(quint32 c =0; c < node->len; c++)
+		{
+		const Node &k =doc->nodes[node->first + 2 * c];
+
+			if((k.type == UInt && n >= 0 && k.u == static_cast<quint64>(n)) || (k.type == Int && k.i == n))
+				return(Value(doc, node->first + 2 * c + 1));
+		}
+
+return(Value());
+}
+
+Document::Value
+Document::Value::operator[](const QString &key) const
+{
+const Node *node =this->node();
+
+	if(!node || node->type != Map)
+		return(Value());
+
+const QByteArray utf8 =key.toUtf8();
+
+	for(quint32 c =0; c < node->len; c++)
+	{
+	const Node &k =doc->nodes[node->first + 2 * c];
+
+		if(k.type == String && k.len == static_cast<quint32>(utf8.size()) && !memcmp(doc->buffer.constData() + k.offset, utf8.constData(), k.len))
+			return(Value(doc, node->first + 2 * c + 1));
+	}
+
+return(Value());
+}
+
+bool
+Document::Value::toBool() const
+{
+const Node *n =node();
+
+	if(!n)
+		return(false);
+
+	switch(n->type)
+	{
+	case Bool:
+		return(n->b);
+	case Int:
+	case UInt:
+		return(n->u != 0);
+	case Float:
+		return(n->f != 0);
+	case Double:
+		return(n->d != 0);
+	default:
+		return(false);
+	}
+}
+
+qint64
+Document::Value::toLongLong() const
+{
+const Node *n =node();
+
+	if(!n)
+		return(0);
+
+	switch(n->type)
+	{
+	case Bool:
+		return(n->b);
+	case Int:
+		return(n->i);
+	case UInt:
+		return(static_cast<qint64>(n->u));
+	case Float:
+		return(static_cast<qint64>(n->f));
+	case Double:
+		return(static_cast<qint64>(n->d));
+	case String:
+		return(toString().toLongLong());
+	default:
+		return(0);
+	}
+}
+
+quint64
+Document::Value::toULongLong() const
+{
+const Node *n =node();
+
+	if(n && n->type == UInt)
+		return(n->u);
+
+	if(n && n->type == String)
+		return(toString().toULongLong());
+
+return(static_cast<quint64>(toLongLong()));
+}
+
+double
+Document::Value::toDouble() const
+{
+const Node *n =node();
+
+	if(!n)
+		return(0);
+
+	switch(n->type)
+	{
+	case Int:
+		return(static_cast<double>(n->i));
+	case UInt:
+		return(static_cast<double>(n->u));
+	case Float:
+		return(n->f);
+	case Double:
+		return(n->d);
+	case String:
+		return(toString().toDouble());
+	default:
+		return(toLongLong());
+	}
+}
+
+QString
+Document::Value::toString() const
+{
+const Node *n =node();
+
+	if(!n)
+		return(QString());
+
+	switch(n->type)
+	{
+	case String:
+	case Binary:
+		return(QString::fromUtf8(doc->buffer.constData() + n->offset, n->len));
+	case Bool:
+		return(n->b ? QStringLiteral("true") : QStringLiteral("false"));
+	case Int:
+		return(QString::number(n->i));
+	case UInt:
+		return(QString::number(n->u));
+	case Float:
+		return(QString::number(n->f));
+	case Double:
+		return(QString::number(n->d, 'g', 17));
+	default:
+		return(QString());
+	}
+}
+
+QByteArray
+Document::Value::toByteArray() const
+{
+const Node *n =node();
+
+	if(n && (n->type == String || n->type == Binary || n->type == Ext))
+		return(QByteArray::fromRawData(doc->buffer.constData() + n->offset, n->len));
+
+return(QByteArray());
+}
+
+QVariant
+Document::Value::toVariant() const
+{
+	if(!node())
+		return(QVariant());
+
+return(doc->node_variant(index));
+}
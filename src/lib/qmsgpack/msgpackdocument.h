@@ -0,0 +1,165 @@
+/*********************************************************************
+ * MsgPack::Document - arena-backed read-only msgpack document
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+*********************************************************************/
+#ifndef MSGPACK_DOCUMENT_H
+#define MSGPACK_DOCUMENT_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QVarLengthArray>
+#include <QVariant>
+#include "msgpack_export.h"
+#include "msgpackcommon.h"
+
+namespace MsgPack
+{
+/************************************************************************************************
+ * All values of the decoded buffer are laid out as nodes of one contiguous array (arena).
+ * Items of an array (or key/value pairs of a map) occupy consecutive nodes.
+ * Strings, binaries and extensions are not copied: nodes keep their offset in the source buffer,
+ * which is held by the document (implicitly shared, no deep copy).
+ * Destroying the document releases the whole tree at once.
+************************************************************************************************/
+class MSGPACK_EXPORT Document
+{
+	struct Node;
+
+public:
+	enum Type : quint8 {
+
+		Invalid =0,
+		Nil,
+		Bool,
+		Int,	// negative integer (or signed msgpack format)
+		UInt,	// positive integer
+		Float,
+		Double,
+		String,
+		Binary,
+		Array,
+		Map,
+		Ext
+	};
+	// Lightweight reference to a node of the document. Valid while the document is alive and unchanged.
+	class MSGPACK_EXPORT Value
+	{
+	public:
+		Value() : doc(nullptr), index(0) { }
+
+		inline Type
+		type() const { return(node() ? node()->type : Invalid); }
+		inline bool
+		isValid() const { return(type() != Invalid); }
+		inline bool
+		isNull() const { return(type() == Nil); }
+		inline bool
+		isArray() const { return(type() == Array); }
+		inline bool
+		isMap() const { return(type() == Map); }
+		inline bool
+		isString() const { return(type() == String); }
+		inline bool
+		isNumber() const { return(type() >= Int && type() <= Double); }
+
+		int
+		size() const; // items of array/map, bytes of string/binary/ext
+		Value
+		operator[](const qint64 n) const; // array: item by position, map: value by integer key
+		Value
+		operator[](const QString &key) const; // map: value by string key
+		Value
+		at(const int i) const; // array: item, map: value - by position
+		Value
+		key(const int i) const; // map: key by position
+
+		bool
+		toBool() const;
+		int
+		toInt() const { return(static_cast<int>(toLongLong())); }
+		uint
+		toUInt() const { return(static_cast<uint>(toULongLong())); }
+		qint64
+		toLongLong() const;
+		quint64
+		toULongLong() const;
+		double
+		toDouble() const;
+		QString
+		toString() const;
+		QByteArray
+		toByteArray() const; // raw data of string/binary/ext without copy (see QByteArray::fromRawData)
+		QVariant
+		toVariant() const; // same result as MsgPack::unpack() of this value
+
+	private:
+		friend class Document;
+
+		Value(const Document *d, const quint32 i) : doc(d), index(i) { }
+
+		inline const Node *
+		node() const { return(doc && index < static_cast<quint32>(doc->nodes.size()) ? &doc->nodes[index] : nullptr); }
+
+		const Document *doc;
+		quint32 index;
+	};
+
+	Document() { }
+	explicit
+	Document(const QByteArray &data) { parse(data); }
+
+	bool
+	parse(const QByteArray &data); // decode all values of the buffer, false - malformed data
+	void
+	clear();
+	inline bool
+	isValid() const { return(roots.size()); }
+	inline int
+	count() const { return(roots.size()); } // quantity of top-level values
+	inline Value
+	at(const int i) const { return(i >= 0 && i < roots.size() ? Value(this, roots[i]) : Value()); }
+	inline Value
+	operator[](const int i) const { return(at(i)); }
+	inline Value
+	root() const { return(at(0)); }
+	inline int
+	nodeCount() const { return(nodes.size()); }
+	inline const QByteArray &
+	data() const { return(buffer); }
+	QVariant
+	toVariant() const; // same result as MsgPack::unpack() of the whole buffer
+
+private:
+	struct Node
+	{
+		Type    type;
+		quint8  code;	// msgpack format byte
+		qint8   ext;	// extension type
+		quint8  reserved;
+		quint32 len;	// items of array/map, bytes of string/binary/ext
+
+		union {
+			bool    b;
+			qint64  i;
+			quint64 u;
+			float   f;
+			double  d;
+			quint32 offset; // string/binary/ext: data offset in the buffer
+			quint32 first;	// array/map: index of the first child node
+		};
+	};
+
+	QByteArray buffer;
+	QVector<Node> nodes;
+	QVarLengthArray<quint32, 4> roots;
+
+	quint8 *
+	parse_node(quint8 *p, const quint8 *end, const quint32 index, const int depth =0);
+	QVariant
+	node_variant(const quint32 index) const;
+};
+
+} // MsgPack
+
+#endif // MSGPACK_DOCUMENT_H
@@ -0,0 +1,701 @@
+/*********************************************************************
+ * MsgPack <-> JSON direct transcoders (without QVariant tree)
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+*********************************************************************/
+#include "msgpackjson.h"
+#include "endianhelper.h"
+#include "private/unpack_p.h"
+#include "private/pack_p.h"
+
+#include <QLocale>
+#include <cmath>
+
+using namespace MsgPack;
+
+namespace {
+
+const int MAX_DEPTH =1024; // nesting of arrays/maps, as QJsonDocument: deeper input is rejected
+/****************************************************************************************
+ *										msgpack -> JSON
+****************************************************************************************/
+void
+json_string(QByteArray &out, const char *s, const quint32 len)
+{
+static const char hex[] ="0123456789abcdef";
+quint32 run =0; // start of the run of chars without escaping
+
+	out +='"';
+
+	for(quint32 c =0; c < len; c++)
+	{
+	const quint8 ch =static_cast<quint8>(s[c]);
+
+		if(ch >= 0x20 && ch != '"' && ch != '\\')
+			continue;
+
+		out.append(s + run, c - run);
+		run =c + 1;
+
+		switch(ch)
+		{
+		case '"':
+			out +="\\\"";
+			break;
+		case '\\':
+			out +="\\\\";
+			break;
+		case '\n':
+			out +="\\n";
+			break;
+		case '\r':
+			out +="\\r";
+			break;
+		case '\t':
+			out +="\\t";
+			break;
+		case '\b':
+			out +="\\b";
+			break;
+		case '\f':
+			out +="\\f";
+			break;
+		default:
+			out +="\\u00";
+			out +=hex[ch >> 4];
+			out +=hex[ch & 0x0f];
+		}
+	}
+
+	out.append(s + run, len - run);
+	out +='"';
+}
+
+void
+json_double(QByteArray &out, const double d)
+{
+	if(std::isfinite(d))
+		out +=QByteArray::number(d, 'g', QLocale::FloatingPointShortest);
+	else
+		out +="null";
+}
+
+quint8 *
+to_json(QByteArray &out, quint8 *p, const quint8 *end, const int depth =0);
+
+quint8 *
+json_key(QByteArray &out, quint8 *p, const quint8 *end, const int depth)
+{
+	if(p >= end)
+		return(nullptr);
+
+	if((*p >= FirstByte::FIXSTR && *p < FirstByte::NIL) || (*p >= FirstByte::STR8 && *p <= FirstByte::STR32))
+		return(to_json(out, p, end, depth));
+
+QByteArray key; // JSON keys are strings only
+
+	p =to_json(key, p, end, depth);
+
+	if(p)
+		json_string(out, key.constData(), key.size());
+
+return(p);
+}
+/****************************************************************************************
+ * Writes one msgpack value at 'p' as JSON.
+ * Return: pointer to the next value or nullptr on malformed data (or nesting over MAX_DEPTH).
+****************************************************************************************/
+quint8 *
+to_json(QByteArray &out, quint8 *p, const quint8 *end, const int depth)
+{
+	if(p >= end)
+		return(nullptr);
+
+const quint8 code =*p;
+
+	if(code <= FirstByte::POSITIVE_FIXINT)
+	{
+		out +=QByteArray::number(code);
+
+	return(p + 1);
+	}
+
+	if(code >= FirstByte::NEGATIVE_FIXINT)
+	{
+		out +=QByteArray::number(static_cast<qint8>(code));
+
+	return(p + 1);
+	}
+
+	if((code >= FirstByte::FIXMAP && code < FirstByte::FIXSTR) || (code >= FirstByte::ARRAY16 && code <= FirstByte::MAP32))
+	{
+	quint32 len =0;
+	bool isMap =false;
+
+		if(depth >= MAX_DEPTH)
+			return(nullptr);
+
+		p =MsgPackPrivate::unpack_container_len(p, end, len, isMap);
+		out +=(isMap ? '{' : '[');
+
+		for(quint32 c =0; c < len && p; c++)
+		{
+			if(c)
+				out +=',';
+
+			if(isMap)
+			{
+				p =json_key(out, p, end, depth + 1);
+
+				if(!p)
+					break;
+
+				out +=':';
+			}
+
+			p =to_json(out, p, end, depth + 1);
+		}
+
+		out +=(isMap ? '}' : ']');
+
+	return(p);
+	}
+
+quint8 *next =MsgPackPrivate::skip(p, end); // bounds check, the value below is read unchecked
+quint8 *v =p + 1;
+
+	if(!next)
+		return(nullptr);
+
+	switch(code)
+	{
+	case FirstByte::NIL:
+	case FirstByte::NEVER_USED:
+		out +="null";
+		break;
+	case FirstByte::MFALSE:
+		out +="false";
+		break;
+	case FirstByte::MTRUE:
+		out +="true";
+		break;
+	case FirstByte::FLOAT32:
+	{
+	quint32 raw =_msgpack_load32(quint32, v);
+	float f;
+
+		memcpy(&f, &raw, 4);
+		json_double(out, f);
+		break;
+	}
+	case FirstByte::FLOAT64:
+	{
+	quint64 raw =_msgpack_load64(quint64, v);
+	double d;
+
+		memcpy(&d, &raw, 8);
+		json_double(out, d);
+		break;
+	}
+	case FirstByte::UINT8:
+		out +=QByteArray::number(*v);
+		break;
+	case FirstByte::UINT16:
+		out +=QByteArray::number(_msgpack_load16(quint16, v));
+		break;
+	case FirstByte::UINT32:
+		out +=QByteArray::number(_msgpack_load32(quint32, v));
+		break;
+	case FirstByte::UINT64:
+		out +=QByteArray::number(_msgpack_load64(quint64, v));
+		break;
+	case FirstByte::INT8:
+		out +=QByteArray::number(static_cast<qint8>(*v));
+		break;
+	case FirstByte::INT16:
+		out +=QByteArray::number(static_cast<qint16>(_msgpack_load16(quint16, v)));
+		break;
+	case FirstByte::INT32:
+		out +=QByteArray::number(static_cast<qint32>(_msgpack_load32(quint32, v)));
+		break;
+	case FirstByte::INT64:
+		out +=QByteArray::number(static_cast<qint64>(_msgpack_load64(quint64, v)));
+		break;
+	case FirstByte::BIN8:
+	case FirstByte::BIN16:
+	case FirstByte::BIN32:
+	{
+	const char *data =reinterpret_cast<const char *>(v + (1 << (code - FirstByte::BIN8)));
+
+		out +='"';
+		out +=QByteArray::fromRawData(data, static_cast<int>(reinterpret_cast<const char *>(next) - data)).toBase64();
+		out +='"';
+		break;
+	}
+	case FirstByte::STR8:
+	case FirstByte::STR16:
+	case FirstByte::STR32:
+		v +=(1 << (code - FirstByte::STR8));
+		json_string(out, reinterpret_cast<const char *>(v), static_cast<quint32>(next - v));
+		break;
+	default:
+		if(code >= FirstByte::FIXSTR && code < FirstByte::NIL)
+			json_string(out, reinterpret_cast<const char *>(v), code & 0x1f);
+		else
+			out +="null"; // ext
+	}
+
+return(next);
+}
+/****************************************************************************************
+ *										JSON -> msgpack
+****************************************************************************************/
+class JsonParser
+{
+public:
+	JsonParser(const QByteArray &json) : p(json.constData()), end(json.constData() + json.size()) { }
+
+	bool
+	parse(QByteArray &result)
+	{
+		out.reserve(end - p);
+
+		if(!value())
+			return(false);
+
+		ws();
+
+		if(p != end) // garbage after the value
+			return(false);
+
+		result =out;
+
+	return(true);
+	}
+
+private:
+	const char *p;
+	const char *end;
+	QByteArray out;
+	QByteArray text; // unescaped string
+	int depth =0; // of the current container
+
+	inline void
+	ws() { while(p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) p++; }
+
+	template<typename F, typename T>
+	inline void
+	write(F packer, const T v)
+	{
+	quint8 buf[9];
+
+		out.append(reinterpret_cast<const char *>(buf), static_cast<int>(packer(v, buf, true) - buf));
+	}
+
+	bool
+	value()
+	{
+		ws();
+
+		if(p >= end)
+			return(false);
+
+		switch(*p)
+		{
+		case '{':
+			return(container(true));
+		case '[':
+			return(container(false));
+		case '"':
+			return(string());
+		case 't':
+			return(literal("true", FirstByte::MTRUE));
+		case 'f':
+			return(literal("false", FirstByte::MFALSE));
+		case 'n':
+			return(literal("null", FirstByte::NIL));
+		default:
+			return(number());
+		}
+	}
+
+	bool
+	literal(const char *word, const quint8 code)
+	{
+	const int len =static_cast<int>(strlen(word));
+
+		if(end - p < len || memcmp(p, word, len))
+			return(false);
+
+		p +=len;
+		out +=static_cast<char>(code);
+
+	return(true);
+	}
+	// The header of array/map is reserved with the max size and shrinked when the quantity of items is known.
+	bool
+	container(const bool isMap)
+	{
+	const char close =(isMap ? '}' : ']');
+	const int pos =out.size();
+	quint32 count =0;
+
+		if(++depth > MAX_DEPTH)
+			return(false);
+
+		p++;
+		out.append(5, '\0');
+		ws();
+
+		if(p < end && *p == close)
+			p++;
+		else
+			for(;;)
+			{
+				if(isMap)
+				{
+					ws();
+
+					if(p >= end || *p != '"' || !string())
+						return(false);
+
+					ws();
+
+					if(p >= end || *p != ':')
+						return(false);
+
+					p++;
+				}
+
+				if(!value())
+					return(false);
+
+				count++;
+				ws();
+
+				if(p >= end)
+					return(false);
+
+				if(*p == ',')
+				{
+					p++;
+					continue;
+				}
+
+				if(*p != close)
+					return(false);
+
+				p++;
+				break;
+			}
+
+	quint8 *hdr =reinterpret_cast<quint8 *>(out.data()) + pos;
+	int size =5;
+
+		if(count <= 15)
+		{
+			*hdr =(isMap ? FirstByte::FIXMAP : FirstByte::FIXARRAY) | count;
+			size =1;
+		}
+		else
+		if(count <= 0xffff)
+		{
+			*hdr =(isMap ? FirstByte::MAP16 : FirstByte::ARRAY16);
+			_msgpack_store16(hdr + 1, count);
+			size =3;
+		}
+		else
+		{
+			*hdr =(isMap ? FirstByte::MAP32 : FirstByte::ARRAY32);
+			_msgpack_store32(hdr + 1, count);
+		}
+
+		if(size < 5)
+			out.remove(pos + size, 5 - size);
+
+		depth--;
+
+	return(true);
+	}
+
+	void
+	write_string(const char *s, const quint32 len)
+	{
+	const int pos =out.size();
+
+		out.resize(pos + len + 5);
+
+	quint8 *dst =reinterpret_cast<quint8 *>(out.data()) + pos;
+
+		out.resize(static_cast<int>(MsgPackPrivate::pack_string_raw(s, len, dst, true) - dst) + pos);
+	}
+
+	bool
+	string()
+	{
+	const char *begin =++p;
+
+		while(p < end && *p != '"' && *p != '\\' && static_cast<quint8>(*p) >= 0x20)
+			p++;
+
+		if(p >= end || static_cast<quint8>(*p) < 0x20)
+			return(false);
+
+		if(*p == '"') // usual case - no escaped chars, copy as is
+		{
+			write_string(begin, static_cast<quint32>(p++ - begin));
+
+		return(true);
+		}
+
+		text =QByteArray(begin, static_cast<int>(p - begin));
+
+		while(p < end && *p != '"')
+		{
+			if(static_cast<quint8>(*p) < 0x20)
+				return(false);
+
+			if(*p != '\\')
+			{
+				text +=*p++;
+				continue;
+			}
+
+			if(++p >= end)
+				return(false);
+
+			switch(*p++)
+			{
+			case '"':
+				text +='"';
+				break;
+			case '\\':
+				text +='\\';
+				break;
+			case '/':
+				text +='/';
+				break;
+			case 'b':
+				text +='\b';
+				break;
+			case 'f':
+				text +='\f';
+				break;
+			case 'n':
+				text +='\n';
+				break;
+			case 'r':
+				text +='\r';
+				break;
+			case 't':
+				text +='\t';
+				break;
+			case 'u':
+			{
+			uint code =0;
+
+				if(!hex4(code))
+					return(false);
+
+				if(code >= 0xd800 && code < 0xdc00) // surrogate pair
+				{
+				uint low =0;
+
+					if(end - p < 6 || p[0] != '\\' || p[1] != 'u')
+						return(false);
+
+					p +=2;
+
+					if(!hex4(low) || low < 0xdc00 || low > 0xdfff)
+						return(false);
+
+					code =0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+				}
+				else
+				if(code >= 0xdc00 && code <= 0xdfff) // lone low surrogate: no UTF-8 of it
+					return(false);
+
+				utf8(code);
+				break;
+			}
+			default:
+				return(false);
+			}
+		}
+
+		if(p >= end)
+			return(false);
+
+		p++;
+		write_string(text.constData(), text.size());
+
+	return(true);
+	}
+
+	bool
+	hex4(uint &code)
+	{
+		if(end - p < 4)
+			return(false);
+
+		for(int c =0; c < 4; c++, p++)
+		{
+		const char ch =*p;
+
+			code <<=4;
+
+			if(ch >= '0' && ch <= '9')
+				code |=(ch - '0');
+			else
+			if(ch >= 'a' && ch <= 'f')
+				code |=(ch - 'a' + 10);
+			else
+			if(ch >= 'A' && ch <= 'F')
+				code |=(ch - 'A' + 10);
+			else
+				return(false);
+		}
+
+	return(true);
+	}
+
+	void
+	utf8(const uint code)
+	{
+		if(code < 0x80)
+			text +=static_cast<char>(code);
+		else
+		if(code < 0x800)
+		{
+			text +=static_cast<char>(0xc0 | (code >> 6));
+			text +=static_cast<char>(0x80 | (code & 0x3f));
+		}
+		else
+		if(code < 0x10000)
+		{
+			text +=static_cast<char>(0xe0 | (code >> 12));
+			text +=static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+			text +=static_cast<char>(0x80 | (code & 0x3f));
+		}
+		else
+		{
+			text +=static_cast<char>(0xf0 | (code >> 18));
+			text +=static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+			text +=static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+			text +=static_cast<char>(0x80 | (code & 0x3f));
+		}
+	}
+
+	bool
+	digits()
+	{
+	const char *begin =p;
+
+		while(p < end && *p >= '0' && *p <= '9')
+			p++;
+
+	return(p > begin);
+	}
+
+	bool
+	number()
+	{
+	const char *begin =p;
+	bool isInteger =true;
+
+		if(p < end && *p == '-')
+			p++;
+
+	const char *integer =p;
+
+		if(!digits() || (*integer == '0' && p - integer > 1)) // no leading zeros
+			return(false);
+
+		if(p < end && *p == '.')
+		{
+			isInteger =false;
+			p++;
+
+			if(!digits())
+				return(false);
+		}
+
+		if(p < end && (*p == 'e' || *p == 'E'))
+		{
+			isInteger =false;
+			p++;
+
+			if(p < end && (*p == '+' || *p == '-'))
+				p++;
+
+			if(!digits())
+				return(false);
+		}
+
+	const QByteArray token =QByteArray::fromRawData(begin, static_cast<int>(p - begin));
+	bool ok =false;
+
+		if(isInteger)
+		{
+			if(*begin == '-')
+			{
+			const qint64 i =token.toLongLong(&ok);
+
+				if(ok)
+					write(MsgPackPrivate::pack_longlong, i);
+			}
+			else
+			{
+			const quint64 u =token.toULongLong(&ok);
+
+				if(ok)
+					write(MsgPackPrivate::pack_ulonglong, u);
+			}
+
+			if(ok)
+				return(true);
+		}
+
+	const double d =token.toDouble(&ok); // fraction, exponent or integer out of 64 bits
+
+		if(ok)
+			write(MsgPackPrivate::pack_double, d);
+
+	return(ok);
+	}
+};
+
+} // namespace
+
+QByteArray
+MsgPack::toJson(const QByteArray &data, const int offset, bool *ok)
+{
+QByteArray out;
+quint8 *p =reinterpret_cast<quint8 *>(const_cast<char *>(data.constData()));
+const quint8 *end =p + data.size();
+bool result =(offset >= 0 && offset < data.size());
+
+	if(result)
+	{
+		out.reserve(data.size() * 2);
+		result =(to_json(out, p + offset, end) != nullptr);
+	}
+
+	if(ok)
+		*ok =result;
+
+return(result ? out : QByteArray());
+}
+
+QByteArray
+MsgPack::fromJson(const QByteArray &json, bool *ok)
+{
+QByteArray out;
+JsonParser parser(json);
+const bool result =parser.parse(out);
+
+	if(ok)
+		*ok =result;
+
+return(out);
+}
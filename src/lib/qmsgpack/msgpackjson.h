@@ -0,0 +1,24 @@
+/*********************************************************************
+ * MsgPack <-> JSON direct transcoders (without QVariant tree)
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+*********************************************************************/
+#ifndef MSGPACK_JSON_H
+#define MSGPACK_JSON_H
+
+#include <QByteArray>
+#include "msgpack_export.h"
+#include "msgpackcommon.h"
+
+namespace MsgPack
+{
+	// msgpack value at 'offset' of 'data' to compact JSON text.
+	// nil/NaN/Inf -> null, binary -> base64 string, ext -> null, non-string map keys -> strings.
+	// Nesting deeper than 1024 arrays/maps fails.
+	MSGPACK_EXPORT QByteArray toJson(const QByteArray &data, const int offset =0, bool *ok =nullptr);
+	// JSON text to msgpack bytes. Integers keep integer types, other numbers -> double.
+	// Nesting deeper than 1024 arrays/objects fails (as QJsonDocument).
+	MSGPACK_EXPORT QByteArray fromJson(const QByteArray &json, bool *ok =nullptr);
+} // MsgPack
+
+#endif // MSGPACK_JSON_H
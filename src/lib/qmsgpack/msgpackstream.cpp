@@ -4,6 +4,7 @@
 #include "private/pack_p.h"
 
 #include <QBuffer>
+#include <QFile>
 #include <QDebug>
 
 #undef  CHECK_STREAM_PRECOND
@@ -25,16 +26,19 @@
     if (q_status != Ok) \
         return retVal;
 
+#define READ_BUFFER_INIT \
+    rpos(0), rbufSize(0), mfile(0), mdata(0), mpos(0), msize(0)
+
 MsgPackStream::MsgPackStream() :
-    dev(0), owndev(false), q_status(Ok), flushWrites(false)
+    dev(0), owndev(false), q_status(Ok), flushWrites(false), READ_BUFFER_INIT
 { }
 
 MsgPackStream::MsgPackStream(QIODevice *d) :
-    dev(d), owndev(false), q_status(Ok), flushWrites(false)
+    dev(d), owndev(false), q_status(Ok), flushWrites(false), READ_BUFFER_INIT
 { }
 
 MsgPackStream::MsgPackStream(QByteArray *a, QIODevice::OpenMode mode) :
-    owndev(true), q_status(Ok), flushWrites(false)
+    owndev(true), q_status(Ok), flushWrites(false), READ_BUFFER_INIT
 {
     QBuffer *buf = new QBuffer(a);
     buf->open(mode);
@@ -42,7 +46,7 @@ MsgPackStream::MsgPackStream(QByteArray *a, QIODevice::OpenMode mode) :
 }
 
 MsgPackStream::MsgPackStream(const QByteArray &a) :
-    owndev(true), q_status(Ok), flushWrites(false)
+    owndev(true), q_status(Ok), flushWrites(false), READ_BUFFER_INIT
 {
     QBuffer *buf = new QBuffer();
     buf->setData(a);
@@ -52,12 +56,16 @@ MsgPackStream::MsgPackStream(const QByteArray &a) :
 
 MsgPackStream::~MsgPackStream()
 {
+    unmapFile();
+    releaseBuffer();
     if (owndev)
         delete dev;
 }
 
 void MsgPackStream::setDevice(QIODevice *d)
 {
+    unmapFile();
+    releaseBuffer();
     if (owndev)
         delete dev;
     dev = d;
@@ -71,6 +79,10 @@ QIODevice *MsgPackStream::device() const
 
 bool MsgPackStream::atEnd() const
 {
+    if (mdata)
+        return mpos >= msize;
+    if (rpos < rbuf.size())
+        return false;
     return dev ? dev->atEnd() : true;
 }
 
@@ -99,6 +111,65 @@ bool MsgPackStream::willFlushWrites()
     return flushWrites;
 }
 
+void MsgPackStream::setReadBufferSize(qint64 size)
+{
+    if (size <= 0)
+        releaseBuffer();
+    rbufSize = qMax(size, qint64(0));
+}
+
+qint64 MsgPackStream::readBufferSize() const
+{
+    return rbufSize;
+}
+
+bool MsgPackStream::mapFile()
+{
+    CHECK_STREAM_PRECOND(false);
+    if (mdata)
+        return true;
+    QFile *file = qobject_cast<QFile *>(dev);
+    if (!file || !file->isOpen())
+        return false;
+    releaseBuffer(); // file position = first unread byte
+    qint64 size = file->size() - file->pos();
+    if (size <= 0)
+        return false;
+    mdata = file->map(file->pos(), size);
+    if (!mdata)
+        return false;
+    mfile = file;
+    mpos = 0;
+    msize = size;
+    return true;
+}
+
+bool MsgPackStream::isMapped() const
+{
+    return mdata != 0;
+}
+
+void MsgPackStream::unmapFile()
+{
+    if (!mdata)
+        return;
+    qint64 pos = mfile->pos() + mpos; // move the file to the first unread byte
+    mfile->unmap(mdata);
+    mfile->seek(pos);
+    mfile = 0;
+    mdata = 0;
+    mpos = msize = 0;
+}
+
+void MsgPackStream::releaseBuffer()
+{
+    qint64 unread = rbuf.size() - rpos;
+    if (unread > 0 && dev && !dev->isSequential())
+        dev->seek(dev->pos() - unread);
+    rbuf.clear();
+    rpos = 0;
+}
+
 MsgPackStream &MsgPackStream::operator>>(bool &b)
 {
     CHECK_STREAM_PRECOND(*this)
@@ -283,6 +354,11 @@ MsgPackStream &MsgPackStream::operator>>(QString &str)
         setStatus(ReadCorruptData);
         return *this;
     }
+    const char *raw = readRawBytes(len); // in place if buffered/mapped
+    if (raw) {
+        str = QString::fromUtf8(raw, len);
+        return *this;
+    }
     quint8 *data = new quint8[len];
     if (!readBytes((char *)data, len)) {
         setStatus(ReadPastEnd);
@@ -334,6 +410,84 @@ MsgPackStream &MsgPackStream::operator>>(QByteArray &array)
 bool MsgPackStream::readBytes(char *data, qint64 len)
 {
     CHECK_STREAM_PRECOND(false);
+    if (mdata) {
+        if (msize - mpos < len) {
+            setStatus(ReadPastEnd);
+            return false;
+        }
+        memcpy(data, mdata + mpos, len);
+        mpos += len;
+        return true;
+    }
+    if (!rbufSize)
+        return readDevice(data, len);
+
+    qint64 avail = rbuf.size() - rpos;
+    if (avail >= len) { // usual case - primitive from the buffer
+        memcpy(data, rbuf.constData() + rpos, len);
+        rpos += len;
+        return true;
+    }
+    memcpy(data, rbuf.constData() + rpos, avail);
+    data += avail;
+    len -= avail;
+    rbuf.clear();
+    rpos = 0;
+    if (len >= rbufSize) // big block - directly to the destination
+        return readDevice(data, len);
+    if (!fillBuffer(len)) {
+        setStatus(ReadPastEnd);
+        return false;
+    }
+    memcpy(data, rbuf.constData(), len);
+    rpos = len;
+    return true;
+}
+
+const char *MsgPackStream::readRawBytes(qint64 len)
+{
+    CHECK_STREAM_PRECOND(0);
+    if (mdata) {
+        if (msize - mpos < len)
+            return 0;
+        const char *p = reinterpret_cast<const char *>(mdata) + mpos;
+        mpos += len;
+        return p;
+    }
+    if (!rbufSize || len > rbufSize)
+        return 0;
+    if (rbuf.size() - rpos < len && !fillBuffer(len))
+        return 0;
+    const char *p = rbuf.constData() + rpos;
+    rpos += len;
+    return p;
+}
+
+/* Reads from the device until the buffer holds at least 'min' unread bytes,
+ * takes everything already available up to the buffer size.
+ */
+bool MsgPackStream::fillBuffer(qint64 min)
+{
+    qint64 got = rbuf.size() - rpos;
+    if (rpos) {
+        rbuf.remove(0, rpos);
+        rpos = 0;
+    }
+    rbuf.resize(qMax(rbufSize, min));
+    while (got < min) {
+        qint64 thisRead = dev->read(rbuf.data() + got, rbuf.size() - got);
+        if (thisRead < 0)
+            break;
+        got += thisRead;
+        if (got < min && thisRead == 0 && !dev->waitForReadyRead(-1))
+            break;
+    }
+    rbuf.resize(got);
+    return got >= min;
+}
+
+bool MsgPackStream::readDevice(char *data, qint64 len)
+{
     qint64 readed = 0;
     qint64 thisRead = 0;
     while (readed < len)
@@ -346,7 +500,10 @@ bool MsgPackStream::readBytes(char *data, qint64 len)
         readed += thisRead;
         /* Data might not be available for a bit, so wait before reading again. */
         if (readed < len) {
-            dev->waitForReadyRead(-1);
+            if (!dev->waitForReadyRead(-1) && thisRead == 0) {
+                thisRead = -1; // end of device
+                break;
+            }
         }
     }
     if (thisRead < 0) {
@@ -9,6 +9,8 @@
 
 #include <QIODevice>
 
+class QFile;
+
 class MSGPACK_EXPORT MsgPackStream
 {
 public:
@@ -29,6 +31,18 @@ public:
     void setFlushWrites(bool flushWrites);
     bool willFlushWrites();
 
+    /* Read-ahead: the device is read by blocks of 'size' bytes, 0 - disabled (default).
+     * Intended for read-only streams; unread bytes are returned to non-sequential
+     * devices (seek back) when the buffer is released, for sequential ones they are lost.
+     */
+    void setReadBufferSize(qint64 size);
+    qint64 readBufferSize() const;
+    /* Maps the rest of the QFile device into memory, reads go without device calls.
+     * Returns false if the device is not an open QFile or can't be mapped.
+     */
+    bool mapFile();
+    bool isMapped() const;
+
     MsgPackStream &operator>>(bool &b);
     MsgPackStream &operator>>(quint8 &u8);
     MsgPackStream &operator>>(quint16 &u16);
@@ -43,6 +57,9 @@ public:
     MsgPackStream &operator>>(QString &str);
     MsgPackStream &operator>>(QByteArray &array);
     bool readBytes(char *data, qint64 len);
+    // next 'len' bytes in place (read buffer or mapped file) without copying, valid until the next read.
+    // nullptr - the stream is not buffered/mapped or 'len' exceeds the buffer, use readBytes()
+    const char *readRawBytes(qint64 len);
     bool readExtHeader(quint32 &len);
 
     MsgPackStream &operator<<(bool b);
@@ -64,6 +81,18 @@ private:
     Status q_status;
     bool flushWrites;
 
+    QByteArray rbuf;    // read-ahead buffer
+    qint64 rpos;        // read position in rbuf
+    qint64 rbufSize;
+    QFile *mfile;       // mapped file
+    uchar *mdata;
+    qint64 mpos;
+    qint64 msize;
+
+    bool readDevice(char *data, qint64 len);
+    bool fillBuffer(qint64 min);
+    void releaseBuffer();
+    void unmapFile();
     bool unpack_longlong(qint64 &i64);
     bool unpack_ulonglong(quint64 &u64);
 };
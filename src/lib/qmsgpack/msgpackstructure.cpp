@@ -0,0 +1,318 @@
+/*********************************************************************
+ * MsgPack::Structure - structural pre-scan index of msgpack buffer
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+*********************************************************************/
+#include "msgpackstructure.h"
+#include "endianhelper.h"
+#include "private/unpack_p.h"
+
+#include <QVarLengthArray>
+#include <QtAlgorithms>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MSGPACK_SCAN_SSE2
+#endif
+
+using namespace MsgPack;
+
+namespace {
+
+enum Shape : quint8 {
+
+	FIXED =0,	// whole value is 'hdr' bytes
+	BLOB,		// str/bin/ext: 'hdr' bytes + length (fixstr: length in the first byte)
+	ARRAY,
+	MAP
+};
+
+struct Kind
+{
+	quint8 shape;
+	quint8 hdr;		// size of the header (FIXED: size of the value)
+	quint8 lenSize; // size of the length field after the first byte, 0 - length in the first byte
+	quint8 reserved;
+};
+
+struct KindTable
+{
+	Kind kinds[256];
+
+	KindTable()
+	{
+		for(int c =0; c < 256; c++)
+		{
+		Kind &k =kinds[c];
+
+			k ={FIXED, 1, 0, 0};
+
+			if(c >= FirstByte::FIXMAP && c < FirstByte::FIXARRAY)
+				k.shape =MAP;
+			else
+			if(c >= FirstByte::FIXARRAY && c < FirstByte::FIXSTR)
+				k.shape =ARRAY;
+			else
+			if(c >= FirstByte::FIXSTR && c < FirstByte::NIL)
+				k.shape =BLOB;
+		}
+
+		kinds[FirstByte::BIN8] ={BLOB, 2, 1, 0};
+		kinds[FirstByte::BIN16] ={BLOB, 3, 2, 0};
+		kinds[FirstByte::BIN32] ={BLOB, 5, 4, 0};
+		kinds[FirstByte::STR8] ={BLOB, 2, 1, 0};
+		kinds[FirstByte::STR16] ={BLOB, 3, 2, 0};
+		kinds[FirstByte::STR32] ={BLOB, 5, 4, 0};
+		kinds[FirstByte::EXT8] ={BLOB, 3, 1, 0}; // + ext type
+		kinds[FirstByte::EXT16] ={BLOB, 4, 2, 0};
+		kinds[FirstByte::EXT32] ={BLOB, 6, 4, 0};
+		kinds[FirstByte::FLOAT32] ={FIXED, 5, 0, 0};
+		kinds[FirstByte::FLOAT64] ={FIXED, 9, 0, 0};
+		kinds[FirstByte::UINT8] ={FIXED, 2, 0, 0};
+		kinds[FirstByte::UINT16] ={FIXED, 3, 0, 0};
+		kinds[FirstByte::UINT32] ={FIXED, 5, 0, 0};
+		kinds[FirstByte::UINT64] ={FIXED, 9, 0, 0};
+		kinds[FirstByte::INT8] ={FIXED, 2, 0, 0};
+		kinds[FirstByte::INT16] ={FIXED, 3, 0, 0};
+		kinds[FirstByte::INT32] ={FIXED, 5, 0, 0};
+		kinds[FirstByte::INT64] ={FIXED, 9, 0, 0};
+		kinds[FirstByte::FIXEXT1] ={FIXED, 3, 0, 0};
+		kinds[FirstByte::FIXEXT2] ={FIXED, 4, 0, 0};
+		kinds[FirstByte::FIXEXT4] ={FIXED, 6, 0, 0};
+		kinds[FirstByte::FIXEXT8] ={FIXED, 10, 0, 0};
+		kinds[FirstByte::FIXEX16] ={FIXED, 18, 0, 0};
+		kinds[FirstByte::ARRAY16] ={ARRAY, 3, 2, 0};
+		kinds[FirstByte::ARRAY32] ={ARRAY, 5, 4, 0};
+		kinds[FirstByte::MAP16] ={MAP, 3, 2, 0};
+		kinds[FirstByte::MAP32] ={MAP, 5, 4, 0};
+	}
+};
+
+const KindTable table;
+
+struct Frame
+{
+	quint64 remaining;	// items left to scan
+	int level;			// level of the container
+	int index;			// index of the container at its level, -1 - not recorded
+};
+
+} // namespace
+
+bool
+Structure::scan(const QByteArray &data, const int depth, const int offset)
+{
+	clear();
+
+	if(depth < 0 || offset < 0 || offset >= data.size())
+		return(false);
+
+	buffer =data; // shared, not copied
+	levels.resize(depth + 1);
+
+const quint8 *base =reinterpret_cast<const quint8 *>(buffer.constData());
+const quint8 *end =base + buffer.size();
+const quint8 *p =base + offset;
+QVarLengthArray<Frame, 32> stack;
+int level =0; // level of the value at 'p'
+bool ok =true;
+
+	for(;;)
+	{
+		if(stack.size())
+		{
+		Frame &top =stack.last();
+
+			if(!top.remaining) // container is complete
+			{
+				if(top.index >= 0)
+					levels[top.level].Ends[top.index] =static_cast<quint32>(p - base);
+
+				stack.removeLast();
+				continue;
+			}
+
+			level =top.level + 1;
+
+#ifdef MSGPACK_SCAN_SSE2
+			// run of 1-byte values (fixint): signed byte >= -32
+			while(top.remaining > 1 && end - p >= 16)
+			{
+			const int mask =_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), _mm_set1_epi8(-33)));
+			quint64 run =(mask == 0xffff ? 16 : qCountTrailingZeroBits(static_cast<quint32>(~mask)));
+
+				if(run > top.remaining)
+					run =top.remaining;
+
+				if(run < 2)
+					break;
+
+				if(level <= depth)
+				{
+				Level &l =levels[level];
+				const quint32 first =static_cast<quint32>(p - base);
+
+					for(quint32 c =0; c < run; c++)
+					{
+						l.Offsets.append(first + c);
+						l.Ends.append(first + c + 1);
+
+						if(level < depth)
+						{
+							l.First.append(levels[level + 1].Offsets.size());
+							l.Items.append(0);
+						}
+					}
+				}
+
+				p +=run;
+				top.remaining -=run;
+
+				if(run < 16)
+					break;
+			}
+
+			if(!top.remaining)
+				continue;
+#endif
+			top.remaining--;
+		}
+		else
+		if(p != base + offset) // root value is complete
+			break;
+
+		if(p >= end)
+		{
+			ok =false;
+			break;
+		}
+
+	const Kind &k =table.kinds[*p];
+	int index =-1;
+
+		if(level <= depth)
+		{
+		Level &l =levels[level];
+
+			index =l.Offsets.size();
+			l.Offsets.append(static_cast<quint32>(p - base));
+			l.Ends.append(0);
+
+			if(level < depth)
+			{
+				l.First.append(levels[level + 1].Offsets.size());
+				l.Items.append(0);
+			}
+		}
+
+		if(end - p < k.hdr)
+		{
+			ok =false;
+			break;
+		}
+
+	quint64 len =0;
+
+		switch(k.lenSize)
+		{
+		case 0:
+			len =(k.shape == BLOB ? (*p & 0x1f) : (*p & 0x0f));
+			break;
+		case 1:
+			len =p[1];
+			break;
+		case 2:
+			len =_msgpack_load16(quint64, const_cast<quint8 *>(p + 1));
+			break;
+		default:
+			len =_msgpack_load32(quint64, const_cast<quint8 *>(p + 1));
+		}
+
+		p +=k.hdr;
+
+		if(k.shape == FIXED || k.shape == BLOB)
+		{
+			if(k.shape == BLOB)
+			{
+				if(static_cast<quint64>(end - p) < len)
+				{
+					ok =false;
+					break;
+				}
+
+				p +=len;
+			}
+
+			if(index >= 0)
+				levels[level].Ends[index] =static_cast<quint32>(p - base);
+
+			continue;
+		}
+
+		if(k.shape == MAP)
+			len *=2;
+
+		if(static_cast<quint64>(end - p) < len) // every item takes at least 1 byte
+		{
+			ok =false;
+			break;
+		}
+
+		if(index >= 0 && level < depth)
+			levels[level].Items[index] =static_cast<quint32>(len);
+
+		stack.append({len, level, index});
+	}
+
+	if(!ok) // malformed or truncated data
+		clear();
+
+return(ok);
+}
+
+void
+Structure::clear()
+{
+	buffer.clear();
+	levels.clear();
+}
+
+int
+Structure::items(const int level, const int i) const
+{
+	if(level < 0 || level >= levels.size() - 1 || i < 0 || i >= levels[level].Items.size())
+		return(0);
+
+return(levels[level].Items[i]);
+}
+
+int
+Structure::child(const int level, const int i, const int n) const
+{
+	if(n < 0 || n >= items(level, i))
+		return(-1);
+
+return(levels[level].First[i] + n);
+}
+
+QByteArray
+Structure::raw(const int level, const int i) const
+{
+	if(i < 0 || i >= count(level))
+		return(QByteArray());
+
+return(QByteArray::fromRawData(buffer.constData() + offset(level, i), size(level, i)));
+}
+
+QVariant
+Structure::value(const int level, const int i) const
+{
+	if(i < 0 || i >= count(level))
+		return(QVariant());
+
+QVariant v;
+
+	MsgPackPrivate::unpack_type(v, reinterpret_cast<quint8 *>(const_cast<char *>(buffer.constData())) + offset(level, i)); // bounds checked by scan()
+
+return(v);
+}
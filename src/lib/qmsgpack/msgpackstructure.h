@@ -0,0 +1,72 @@
+/*********************************************************************
+ * MsgPack::Structure - structural pre-scan index of msgpack buffer
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+*********************************************************************/
+#ifndef MSGPACK_STRUCTURE_H
+#define MSGPACK_STRUCTURE_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QVariant>
+#include "msgpack_export.h"
+#include "msgpackcommon.h"
+
+namespace MsgPack
+{
+/************************************************************************************************
+ * One pass over the buffer records byte spans of all elements down to the chosen depth,
+ * no values are created. Level 0 is the root value, level 1 - items of the root container,
+ * level 2 - items of those items (e.g. fields of tuples) and so on.
+ * Items of a map are its keys and values in turn (key = 2 * n, value = 2 * n + 1).
+ * The scanner is table-driven; runs of 1-byte values (fixint) are skipped 16 bytes at a time with SSE2.
+************************************************************************************************/
+class MSGPACK_EXPORT Structure
+{
+public:
+	Structure() { }
+	Structure(const QByteArray &data, const int depth =1, const int offset =0) { scan(data, depth, offset); }
+
+	bool
+	scan(const QByteArray &data, const int depth =1, const int offset =0); // value at 'offset', false - malformed data
+	void
+	clear();
+
+	inline bool
+	isValid() const { return(levels.size()); }
+	inline int
+	depth() const { return(levels.size() - 1); }
+	inline int
+	count(const int level) const { return(level >= 0 && level < levels.size() ? levels[level].Offsets.size() : 0); }
+	inline quint32
+	offset(const int level, const int i) const { return(levels[level].Offsets[i]); }
+	inline quint32
+	size(const int level, const int i) const { return(levels[level].Ends[i] - levels[level].Offsets[i]); }
+	int
+	items(const int level, const int i) const; // quantity of items of the container (map: keys + values), 0 - not a container
+	int
+	child(const int level, const int i, const int n) const; // index at 'level + 1' of the n-th item of the container, -1 - none
+
+	QByteArray
+	raw(const int level, const int i) const; // msgpack bytes of the element without copy
+	QVariant
+	value(const int level, const int i) const; // decoded element
+	inline const QByteArray &
+	data() const { return(buffer); }
+
+private:
+	struct Level
+	{
+		QVector<quint32> Offsets;
+		QVector<quint32> Ends;
+		QVector<quint32> First;	// containers (except the last level): index of the first item at the next level
+		QVector<quint32> Items;
+	};
+
+	QByteArray buffer;
+	QVector<Level> levels;
+};
+
+} // MsgPack
+
+#endif // MSGPACK_STRUCTURE_H
@@ -71,6 +71,9 @@ QMetaType::Type t =(QMetaType::Type)v.type();
 	if(t == QMetaType::QVariantMap)
         p = pack_map(v.toMap(), p, wr, user_data);
 	else
+	if(t == QMetaType::User && v.userType() == qMetaTypeId<MsgPack::Packed>())
+		p = pack_raw(v.value<MsgPack::Packed>().Data, p, wr);
+	else
 	{
 		if(t == QMetaType::User)
 			t =(QMetaType::Type)v.userType();
@@ -454,6 +457,15 @@ return(p);
 }
 
 
+quint8 *
+MsgPackPrivate::pack_raw(const QByteArray &arr, quint8 *p, bool wr)
+{
+	if(wr)
+		memcpy(p, arr.constData(), arr.size());
+
+return(p + arr.size());
+}
+
 //quint8 *
 //MsgPackPrivate::pack_map(const QVariantMap &map, quint8 *p, bool wr, QVector<QByteArray> &user_data)
 //{
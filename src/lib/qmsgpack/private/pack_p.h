@@ -51,6 +51,7 @@ quint8 * pack_bin_header(quint32 len, quint8 *p, bool wr);
 quint8 * pack_bin(const QByteArray &arr, quint8 *p, bool wr);
 //quint8 * pack_map(const QVariantMap &map, quint8 *p, bool wr, QVector<QByteArray> &user_data);
 //quint8 * pack_map(const QUIntMap &map, quint8 *p, bool wr, QVector<QByteArray> &user_data);
+quint8 * pack_raw(const QByteArray &arr, quint8 *p, bool wr);
 quint8 * pack_user(const QVariant &v, quint8 *p, bool wr, QVector<QByteArray> &user_data);
 
 template<class T>
@@ -8,6 +8,10 @@
 #include <QMap>
 #include <QReadLocker>
 #include <QWriteLocker>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QAtomicInt>
 
 MsgPackPrivate::type_parser_f MsgPackPrivate::unpackers[32] = {
     MsgPackPrivate::unpack_nil,
@@ -46,6 +50,70 @@ MsgPackPrivate::type_parser_f MsgPackPrivate::unpackers[32] = {
 
 QHash<qint8, MsgPack::unpack_user_f> MsgPackPrivate::user_unpackers;
 QReadWriteLock MsgPackPrivate::unpackers_lock;
+quint32 MsgPackPrivate::parallel_threshold =0;
+
+namespace {
+
+thread_local const quint8 *unpack_end =nullptr; // end of the buffer of current unpack(), nullptr - unknown
+thread_local bool in_parallel =false; // no nested parallel decode inside segments
+
+const quint32 SEGMENT_MIN =256; // items
+
+/* Segments of the array are taken by free threads one by one (the caller thread works too),
+ * so a thread with light segments takes more of them.
+ */
+struct ParallelJob
+{
+	QVector<quint8 *> starts;	// first byte of each segment
+	QVector<quint32> counts;	// items in each segment
+	QVector<QVariantList> results;
+	QVariantList *res =nullptr; // results.data(), taken once before the threads start
+	QAtomicInt next;
+
+	void
+	work()
+	{
+	const bool nested =in_parallel;
+	int s;
+
+		in_parallel =true;
+
+		while((s =next.fetchAndAddRelaxed(1)) < counts.size())
+		{
+		quint8 *p =starts.at(s);
+		QVariant v;
+
+			res[s].reserve(counts.at(s));
+
+			for(quint32 c =0; c < counts.at(s); c++)
+			{
+				p =MsgPackPrivate::unpack_type(v, p);
+				res[s].append(v);
+			}
+		}
+
+		in_parallel =nested;
+	}
+};
+
+class SegmentTask : public QRunnable
+{
+public:
+	SegmentTask(ParallelJob *job, QSemaphore *done) : job(job), done(done) { }
+
+	void
+	run() override
+	{
+		job->work();
+		done->release();
+	}
+
+private:
+	ParallelJob *job;
+	QSemaphore *done;
+};
+
+} // namespace
 
 QVariant
 MsgPackPrivate::unpack(const quint8 *p, const quint8 *end)
@@ -53,6 +121,9 @@ MsgPackPrivate::unpack(const quint8 *p, const quint8 *end)
 QVariantList d;
 QVariant v;
 quint8 *pos = const_cast<quint8 *>(p); // FIXME
+const quint8 *prev_end =unpack_end; // unpack() may be called from user unpacker
+
+	unpack_end =end + 1;
 
 	while(pos <= end)
 	{
@@ -60,6 +131,8 @@ quint8 *pos = const_cast<quint8 *>(p); // FIXME
         d.append(v);
     }
 
+	unpack_end =prev_end;
+
 	if(pos - end > 1)
 		return(QVariant());
 
@@ -309,6 +382,9 @@ quint8 * MsgPackPrivate::unpack_bin32(QVariant &v, quint8 *p)
 
 quint8 * MsgPackPrivate::unpack_array_len(QVariant &v, quint8 *p, quint32 len)
 {
+	if(parallel_threshold && len >= parallel_threshold && len >= 2 * SEGMENT_MIN && unpack_end && !in_parallel)
+		return(unpack_array_parallel(v, p, len));
+
     QVariantList arr;
 
     QVariant vu;
@@ -320,6 +396,70 @@ quint8 * MsgPackPrivate::unpack_array_len(QVariant &v, quint8 *p, quint32 len)
     return p;
 }
 
+/************************************************************************************************
+ * Splits the array into segments by fast structural skip and decodes the segments
+ * on QThreadPool::globalInstance(), then joins the partial lists in order.
+************************************************************************************************/
+quint8 *
+MsgPackPrivate::unpack_array_parallel(QVariant &v, quint8 *p, quint32 len)
+{
+QThreadPool *pool =QThreadPool::globalInstance();
+const quint32 segments =qBound(1U, qMin(static_cast<quint32>(pool->maxThreadCount()) * 4, len / SEGMENT_MIN), len);
+const quint32 per_segment =(len + segments - 1) / segments;
+ParallelJob job;
+QSemaphore done;
+int helpers =0;
+quint8 *begin =p;
+
+	job.starts.reserve(segments);
+	job.counts.reserve(segments);
+
+	for(quint32 c =0; c < len && p; c++)
+	{
+		if(!(c % per_segment))
+		{
+			job.starts.append(p);
+			job.counts.append(qMin(per_segment, len - c));
+		}
+
+		p =skip(p, unpack_end);
+	}
+
+	if(!p) // malformed data, decode as before
+	{
+	const bool nested =in_parallel;
+
+		in_parallel =true;
+		p =unpack_array_len(v, begin, len);
+		in_parallel =nested;
+
+	return(p);
+	}
+
+	job.results.resize(job.counts.size());
+	job.res =job.results.data();
+
+	for(int c =1; c < job.counts.size() && c < pool->maxThreadCount(); c++)
+		if(pool->tryStart(new SegmentTask(&job, &done)))
+			helpers++;
+		else
+			break;
+
+	job.work();
+	done.acquire(helpers);
+
+QVariantList arr;
+
+	arr.reserve(len);
+
+	for(const auto &part : job.results)
+		arr.append(part);
+
+	v =arr;
+
+return(p);
+}
+
 quint8 * MsgPackPrivate::unpack_fixarray(QVariant &v, quint8 *p)
 {
     quint32 len = (*p++) & 0x0f; // 0b00001111
@@ -482,3 +622,145 @@ bool MsgPackPrivate::register_unpacker(qint8 msgpack_type, MsgPack::unpack_user_
     user_unpackers.insert(msgpack_type, unpacker);
     return true;
 }
+
+quint8 *
+MsgPackPrivate::skip(quint8 *p, const quint8 *end)
+{
+quint64 pending =1; // values left to skip, nested items are added to the counter
+
+	while(pending--)
+	{
+		if(p >= end)
+			return(nullptr);
+
+	const quint8 code =*p++;
+	quint64 len =0;	// bytes of value data to skip
+
+		if(code <= MsgPack::FirstByte::POSITIVE_FIXINT || code >= MsgPack::FirstByte::NEGATIVE_FIXINT)
+			continue;
+		else
+		if(code < MsgPack::FirstByte::FIXARRAY)
+			pending +=2 * (code & 0x0f);
+		else
+		if(code < MsgPack::FirstByte::FIXSTR)
+			pending +=(code & 0x0f);
+		else
+		if(code < MsgPack::FirstByte::NIL)
+			len =(code & 0x1f);
+		else
+		{
+		int lenSize =0;
+
+			switch(code)
+			{
+			case MsgPack::FirstByte::BIN8:
+			case MsgPack::FirstByte::STR8:
+				lenSize =1;
+				break;
+			case MsgPack::FirstByte::BIN16:
+			case MsgPack::FirstByte::STR16:
+			case MsgPack::FirstByte::ARRAY16:
+			case MsgPack::FirstByte::MAP16:
+				lenSize =2;
+				break;
+			case MsgPack::FirstByte::BIN32:
+			case MsgPack::FirstByte::STR32:
+			case MsgPack::FirstByte::ARRAY32:
+			case MsgPack::FirstByte::MAP32:
+				lenSize =4;
+				break;
+			case MsgPack::FirstByte::EXT8:
+				lenSize =1;
+				len =1; // + ext type
+				break;
+			case MsgPack::FirstByte::EXT16:
+				lenSize =2;
+				len =1;
+				break;
+			case MsgPack::FirstByte::EXT32:
+				lenSize =4;
+				len =1;
+				break;
+			case MsgPack::FirstByte::FIXEXT1:
+			case MsgPack::FirstByte::FIXEXT2:
+			case MsgPack::FirstByte::FIXEXT4:
+			case MsgPack::FirstByte::FIXEXT8:
+			case MsgPack::FirstByte::FIXEX16:
+				len =1 + (1 << (code - MsgPack::FirstByte::FIXEXT1));
+				break;
+			case MsgPack::FirstByte::FLOAT32:
+				len =4;
+				break;
+			case MsgPack::FirstByte::FLOAT64:
+				len =8;
+				break;
+			case MsgPack::FirstByte::UINT8:
+			case MsgPack::FirstByte::UINT16:
+			case MsgPack::FirstByte::UINT32:
+			case MsgPack::FirstByte::UINT64:
+			case MsgPack::FirstByte::INT8:
+			case MsgPack::FirstByte::INT16:
+			case MsgPack::FirstByte::INT32:
+			case MsgPack::FirstByte::INT64:
+				len =1 << ((code - MsgPack::FirstByte::UINT8) & 0x03);
+				break;
+			default: // nil, never used, false, true
+				break;
+			}
+
+			if(end - p < lenSize)
+				return(nullptr);
+
+		quint64 size =(lenSize == 1 ? *p :
+					   lenSize == 2 ? _msgpack_load16(quint64, p) :
+					   lenSize == 4 ? _msgpack_load32(quint64, p) : 0);
+
+			p +=lenSize;
+
+			if(code == MsgPack::FirstByte::ARRAY16 || code == MsgPack::FirstByte::ARRAY32)
+				pending +=size;
+			else
+			if(code == MsgPack::FirstByte::MAP16 || code == MsgPack::FirstByte::MAP32)
+				pending +=2 * size;
+			else
+				len +=size;
+		}
+
+		if(static_cast<quint64>(end - p) < len)
+			return(nullptr);
+
+		p +=len;
+	}
+
+return(p);
+}
+
+quint8 *
+MsgPackPrivate::unpack_container_len(quint8 *p, const quint8 *end, quint32 &len, bool &isMap)
+{
+	if(p >= end)
+		return(nullptr);
+
+const quint8 code =*p++;
+
+	isMap =(code < MsgPack::FirstByte::FIXARRAY || code == MsgPack::FirstByte::MAP16 || code == MsgPack::FirstByte::MAP32);
+
+	if(code >= MsgPack::FirstByte::FIXMAP && code < MsgPack::FirstByte::FIXSTR)
+		len =(code & 0x0f);
+	else
+	if((code == MsgPack::FirstByte::ARRAY16 || code == MsgPack::FirstByte::MAP16) && end - p >= 2)
+	{
+		len =_msgpack_load16(quint32, p);
+		p +=2;
+	}
+	else
+	if((code == MsgPack::FirstByte::ARRAY32 || code == MsgPack::FirstByte::MAP32) && end - p >= 4)
+	{
+		len =_msgpack_load32(quint32, p);
+		p +=4;
+	}
+	else
+		return(nullptr);
+
+return(p);
+}
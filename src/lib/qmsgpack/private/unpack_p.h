@@ -21,6 +21,7 @@ extern type_parser_f unpackers[32];
 bool register_unpacker(qint8 msgpack_type, MsgPack::unpack_user_f unpacker);
 extern QHash<qint8, MsgPack::unpack_user_f> user_unpackers;
 extern QReadWriteLock unpackers_lock;
+extern quint32 parallel_threshold; // arrays of this size and more are decoded on QThreadPool, 0 - disabled
 
 // goes from p to end unpacking types with unpack_type function below
 QVariant unpack(const quint8 *p, const quint8 *end);
@@ -56,6 +57,7 @@ quint8 * unpack_bin16(QVariant &v, quint8 *p);
 quint8 * unpack_bin32(QVariant &v, quint8 *p);
 
 quint8 * unpack_array_len(QVariant &v, quint8 *p, quint32 len);
+quint8 * unpack_array_parallel(QVariant &v, quint8 *p, quint32 len);
 quint8 * unpack_fixarray(QVariant &v, quint8 *p);
 quint8 * unpack_array16(QVariant &v, quint8 *p);
 quint8 * unpack_array32(QVariant &v, quint8 *p);
@@ -75,6 +77,14 @@ quint8 * unpack_fixext16(QVariant &v, quint8 *p);
 quint8 * unpack_ext8(QVariant &v, quint8 *p);
 quint8 * unpack_ext16(QVariant &v, quint8 *p);
 quint8 * unpack_ext32(QVariant &v, quint8 *p);
+
+/* bounds-checked navigation without decoding:
+ * return pointer past the value (header), or nullptr if data is truncated
+ */
+// skips one value with all nested items
+quint8 * skip(quint8 *p, const quint8 *end);
+// reads header of array/map, len - items of array or pairs of map (nullptr if not a container)
+quint8 * unpack_container_len(quint8 *p, const quint8 *end, quint32 &len, bool &isMap);
 }
 
 #endif // MSGPACK_P_H
@@ -0,0 +1,418 @@
+/******************************************************************
+ * QTNT::LocalReplica - in-memory mirror of a space
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+ * license: GPLv3 2007 - https://www.gnu.org/licenses/gpl-3.0.html
+******************************************************************/
+#include "localreplica.h"
+
+using namespace QTNT;
+
+namespace {
+// null < bool < number < string < binary < other, as in 'scalar' indexes
+int
+rank(const QVariant &v)
+{
+	switch(static_cast<int>(v.type()))
+	{
+	case QVariant::Invalid:
+		return(0);
+	case QVariant::Bool:
+		return(1);
+	case QVariant::Int:
+	case QVariant::UInt:
+	case QVariant::LongLong:
+	case QVariant::ULongLong:
+	case QVariant::Double:
+	case QMetaType::Float:
+		return(2);
+	case QVariant::String:
+		return(3);
+	case QVariant::ByteArray:
+		return(4);
+	default:
+		return(5);
+	}
+}
+
+int
+compare_values(const QVariant &a, const QVariant &b)
+{
+const int ra =rank(a);
+const int rb =rank(b);
+
+	if(ra != rb)
+		return(ra < rb ? -1 : 1);
+
+	switch(ra)
+	{
+	case 1:
+		return(int(a.toBool()) - int(b.toBool()));
+	case 2:
+	{
+		if(a.type() == QVariant::Double || b.type() == QVariant::Double
+		   || static_cast<int>(a.type()) == QMetaType::Float || static_cast<int>(b.type()) == QMetaType::Float)
+		{
+		const double da =a.toDouble(), db =b.toDouble();
+
+			return(da < db ? -1 : (da > db ? 1 : 0));
+		}
+
+	const bool aNeg =((a.type() == QVariant::Int || a.type() == QVariant::LongLong) && a.toLongLong() < 0);
+	const bool bNeg =((b.type() == QVariant::Int || b.type() == QVariant::LongLong) && b.toLongLong() < 0);
+
+		if(aNeg != bNeg)
+			return(aNeg ? -1 : 1);
+
+		if(aNeg)
+			return(a.toLongLong() < b.toLongLong() ? -1 : (a.toLongLong() > b.toLongLong() ? 1 : 0));
+
+		return(a.toULongLong() < b.toULongLong() ? -1 : (a.toULongLong() > b.toULongLong() ? 1 : 0));
+	}
+	case 3: // binary collation of the server: UTF-8 bytes, not UTF-16 units
+	{
+	const QByteArray sa =a.toString().toUtf8(), sb =b.toString().toUtf8();
+
+		return(sa < sb ? -1 : (sb < sa ? 1 : 0));
+	}
+	case 4:
+	{
+	const QByteArray ba =a.toByteArray(), bb =b.toByteArray();
+
+		return(ba < bb ? -1 : (bb < ba ? 1 : 0));
+	}
+	default:
+		return(0);
+	}
+}
+// parts of both keys in turn, the shorter key is a prefix
+int
+compare_keys(const QVariantList &a, const QVariantList &b)
+{
+const int n =qMin(a.size(), b.size());
+
+	for(int c =0; c < n; c++)
+		if(const int r =compare_values(a[c], b[c]))
+			return(r);
+
+return(0);
+}
+
+} // namespace
+
+bool
+LocalReplica::KeyLess::operator()(const QVariantList &a, const QVariantList &b) const
+{
+	return(compare_keys(a, b) < 0);
+}
+
+LocalReplica::LocalReplica(QTarantool *tnt, const QString &spaceName, QObject *parent) :
+	QObject(parent), tnt(tnt), SpaceName(spaceName)
+{
+	connect(tnt, &QTarantool::signalFeedLost, this, [this](const QString &spaceName, const QString &consumer) {
+
+		if(spaceName == SpaceName && consumer == Consumer && bStarted)
+			start(PageSize, FeedLimit);
+	});
+}
+/****************************************************************************************
+ * The feed is subscribed before the scan: changes made during the scan are delivered
+ * after it (replace and delete by primary key can be repeated).
+ * The new copy (with its index definitions) replaces the old one at once,
+ * the readers are not blocked by the load.
+****************************************************************************************/
+bool
+LocalReplica::start(const int pageSize, const int feedLimit)
+{
+QHash<QString, Index> indexes;
+QString primaryName;
+
+	PageSize =qMax(pageSize, 1);
+	FeedLimit =qMax(feedLimit, 1);
+	bStarted =false;
+
+	if(!loadIndexes(indexes, primaryName))
+		return(false);
+
+	if(Consumer.size())
+		tnt->unsubscribe(SpaceName, Consumer);
+
+	Consumer =tnt->subscribe(SpaceName, [this](const QList<CHANGE> &changes) { apply(changes); return(true); }, "", PageSize, FeedLimit);
+
+	if(Consumer.isEmpty())
+		return(false);
+
+const qint64 seq =tnt->feedSequence(SpaceName, Consumer);
+QVariantList last; // primary key of the last loaded tuple
+
+	forever
+	{
+	const QVariantList &page =tnt->getData(SpaceName, last.isEmpty() ? QTarantool::Selector(ALL, {}, primaryName)
+																	 : QTarantool::Selector(GT, last, primaryName), {}, PageSize);
+
+		if(page.isEmpty() && tnt->getLastError().code)
+		{
+			tnt->unsubscribe(SpaceName, Consumer);
+			Consumer.clear();
+
+		return(false);
+		}
+
+		for(const auto &tuple : page)
+			put(indexes, primaryName, tuple.toList());
+
+		if(page.size() < PageSize)
+			break;
+
+		last =key(indexes[primaryName], page.last().toList());
+	}
+
+	Lock.lockForWrite();
+	Indexes.swap(indexes);
+	PrimaryName =primaryName;
+	Seq =seq;
+	Lock.unlock();
+
+	bStarted =true;
+
+return(true);
+}
+/****************************************************************************************
+ * Applies the changes of the feed waiting on the server now.
+****************************************************************************************/
+bool
+LocalReplica::sync()
+{
+	return(bStarted && tnt->pollFeed(SpaceName, Consumer));
+}
+
+void
+LocalReplica::apply(const QList<CHANGE> &changes)
+{
+	Lock.lockForWrite();
+
+	for(const auto &change : changes)
+		if(change.New.size())
+			put(Indexes, PrimaryName, change.New);
+		else
+			remove(Indexes, PrimaryName, change.Old);
+
+	Seq =changes.last().Seq;
+	Lock.unlock();
+
+	emit signalSynced(changes.last().Seq);
+}
+/****************************************************************************************
+ * Parts of the space indexes from _vindex: [{field =N, type =...}, ...] or [[N, type], ...].
+****************************************************************************************/
+bool
+LocalReplica::loadIndexes(QHash<QString, Index> &indexes, QString &primaryName)
+{
+const uint spaceId =tnt->getSpaceId(SpaceName);
+
+	if(!spaceId)
+		return(false);
+
+const QVariantList rows =tnt->getData("_vindex", {EQ, {spaceId}});
+
+QList<int> primaryFields;
+
+	for(const auto &row : rows)
+	{
+	const QVariantList t =row.toList(); // [space_id, iid, name, type, opts, parts]
+	Index index;
+
+		index.bPrimary =(t.value(1).toUInt() == 0);
+
+		for(const auto &part : t.value(5).toList())
+			if(part.type() == QVariant::Map)
+				index.Fields.append(part.toMap().value("field").toInt());
+			else
+				index.Fields.append(part.toList().value(0).toInt());
+
+		if(index.bPrimary)
+		{
+			primaryName =t.value(2).toString();
+			primaryFields =index.Fields;
+		}
+
+		indexes.insert(t.value(2).toString(), index);
+	}
+
+	for(auto &index : indexes)
+		index.KeyFields =(index.bPrimary ? index.Fields : index.Fields + primaryFields);
+
+return(!primaryName.isEmpty());
+}
+/****************************************************************************************
+ * Key of the tuple in the index. Keys of a secondary index are made unique
+ * by the primary key parts ('bUnique').
+****************************************************************************************/
+QVariantList
+LocalReplica::key(const Index &index, const QVariantList &tuple, const bool bUnique) const
+{
+const QList<int> &fields =(bUnique ? index.KeyFields : index.Fields);
+QVariantList k;
+
+	k.reserve(fields.size());
+
+	for(const int f : fields)
+		k.append(tuple.value(f));
+
+return(k);
+}
+
+void
+LocalReplica::put(QHash<QString, Index> &indexes, const QString &primaryName, const QVariantList &tuple)
+{
+	remove(indexes, primaryName, tuple);
+
+	for(auto &index : indexes)
+		index.Tuples[key(index, tuple)] =tuple;
+}
+/****************************************************************************************
+ * Removes the stored tuple with the primary key of 'tuple' from all indexes.
+****************************************************************************************/
+void
+LocalReplica::remove(QHash<QString, Index> &indexes, const QString &primaryName, const QVariantList &tuple)
+{
+Tree &primary =indexes[primaryName].Tuples;
+const auto it =primary.find(key(indexes[primaryName], tuple));
+
+	if(it == primary.end())
+		return;
+
+const QVariantList old =it->second;
+
+	for(auto &index : indexes)
+		index.Tuples.erase(key(index, old));
+}
+/****************************************************************************************
+ * Same result as QTarantool::getData(selectorFrom, selectorTo, limit).
+****************************************************************************************/
+QVariantList
+LocalReplica::getData(const QTarantool::Selector &selectorFrom, const QTarantool::Selector &selectorTo, const uint limit)
+{
+QReadLocker lock(&Lock);
+const auto ix =Indexes.constFind(selectorFrom.IndexName);
+
+	if(ix == Indexes.constEnd())
+		return({});
+
+	if(selectorTo.Operator) // if !ALL
+		if((selectorFrom.Operator < LE && selectorTo.Operator < LE) || (selectorFrom.Operator >= LE && selectorTo.Operator >= LE))
+			return({}); // unidirectional selectors
+
+const Tree &tree =ix->Tuples;
+// range [first, last) of the iterator and its direction
+auto range =[&tree](const OPERATOR op, const QVariantList &k, Tree::const_iterator &first, Tree::const_iterator &last) {
+
+		first =tree.cbegin();
+		last =tree.cend();
+
+		switch(op)
+		{
+		case EQ:
+		case REQ:
+			first =tree.lower_bound(k);
+			last =tree.upper_bound(k);
+			break;
+		case ALL:
+		case GE:
+			first =tree.lower_bound(k);
+			break;
+		case GT:
+			if(k.size())
+				first =tree.upper_bound(k);
+			break;
+		case LE:
+			last =tree.upper_bound(k);
+			break;
+		case LT:
+			if(k.size())
+				last =tree.lower_bound(k);
+			break;
+		}
+
+	return(op < LE); // forward
+	};
+
+Tree::const_iterator first, last;
+const bool fwd =range(selectorFrom.Operator, selectorFrom.Key.values(), first, last);
+QVariantList stop; // index key of the last tuple of the selection
+
+	if(selectorTo.Operator) // the first tuple of 'selectorTo'
+	{
+	Tree::const_iterator to_first, to_last;
+
+		if(range(selectorTo.Operator, selectorTo.Key.values(), to_first, to_last))
+		{
+			if(to_first == to_last)
+				return({});
+
+			stop =key(*ix, to_first->second, false);
+		}
+		else
+		{
+			if(to_first == to_last)
+				return({});
+
+			stop =key(*ix, std::prev(to_last)->second, false);
+		}
+	}
+
+QVariantList result;
+
+	for(uint n =0; n < limit && first != last; n++)
+	{
+	const QVariantList &tuple =(fwd ? first->second : std::prev(last)->second);
+
+		if(stop.size())
+		{
+		const int c =compare_keys(key(*ix, tuple, false), stop);
+
+			if(fwd ? c > 0 : c < 0)
+				break;
+		}
+
+		result.append(QVariant(tuple));
+
+		if(fwd)
+			++first;
+		else
+			--last;
+	}
+
+return(result);
+}
+
+QVariantList
+LocalReplica::get(const IndexKey &key)
+{
+QReadLocker lock(&Lock);
+const auto ix =Indexes.constFind(PrimaryName);
+
+	if(ix == Indexes.constEnd())
+		return({});
+
+const auto it =ix->Tuples.find(key.values());
+
+return(it != ix->Tuples.end() ? it->second : QVariantList());
+}
+
+int
+LocalReplica::count()
+{
+QReadLocker lock(&Lock);
+const auto ix =Indexes.constFind(PrimaryName);
+
+return(ix != Indexes.constEnd() ? static_cast<int>(ix->Tuples.size()) : 0);
+}
+
+qint64
+LocalReplica::sequence()
+{
+QReadLocker lock(&Lock);
+
+return(Seq);
+}
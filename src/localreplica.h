@@ -0,0 +1,93 @@
+#pragma once
+/******************************************************************
+ * QTNT::LocalReplica - in-memory mirror of a space
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+ * license: GPLv3 2007 - https://www.gnu.org/licenses/gpl-3.0.html
+******************************************************************/
+#include <QReadWriteLock>
+#include <map>
+#include "qtarantool.h"
+
+namespace QTNT
+{
+/************************************************************************************************
+ * Copy of the whole space in the process memory with ordered indexes built from the parts
+ * of the space indexes (_vindex). start() subscribes to the change feed of the space
+ * (QTarantool::subscribe(), the log keeps last 'feedLimit' changes) and loads the space
+ * by pages of the primary index, the changes are applied as they come. When the log
+ * does not reach back (or the server was restarted) the space is loaded again.
+ * getData() has the semantics of QTarantool::getData() and is answered locally,
+ * it can be called from any thread. Values are compared in binary order (no collations).
+ *
+ *	LocalReplica tariffs(&tnt, "Tariffs");
+ *
+ *		tariffs.start();
+ *		tariffs.getData({GE, {100}}, {LT, {200}});
+************************************************************************************************/
+class LocalReplica : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit LocalReplica(QTarantool *tnt, const QString &spaceName, QObject *parent =nullptr); // 'tnt' must outlive the replica
+	~LocalReplica() { if(Consumer.size()) tnt->unsubscribe(SpaceName, Consumer); }
+
+	bool
+	start(const int pageSize =10000, const int feedLimit =100000); // loads the space and follows its changes
+	bool
+	sync(); // applies the changes of the feed now (called on every feed event)
+	QVariantList
+	getData(const QTarantool::Selector &selectorFrom, const QTarantool::Selector &selectorTo ={}, const uint limit =1000);
+	QVariantList
+	get(const IndexKey &key); // tuple by primary key, empty - not found
+	int
+	count(); // tuples
+	qint64
+	sequence(); // the last applied change of the feed
+
+private:
+	// compares the parts present in both keys: a partial key is equal to all keys with its prefix
+	struct KeyLess
+	{
+		bool
+		operator()(const QVariantList &a, const QVariantList &b) const;
+	};
+
+	typedef std::map<QVariantList, QVariantList, KeyLess> Tree; // index key : tuple
+
+	struct Index
+	{
+		QList<int> Fields; // from 0
+		QList<int> KeyFields; // of the tree key: secondary - Fields + primary key parts
+		bool bPrimary =false;
+		Tree Tuples; // secondary: key + primary key parts (unique)
+	};
+
+	QTarantool *tnt;
+	const QString SpaceName;
+	QString Consumer; // of the feed subscription, other subscriptions to the space are not touched
+	QString PrimaryName;
+	QHash<QString, Index> Indexes;
+	QReadWriteLock Lock; // guards Indexes, PrimaryName and Seq
+	qint64 Seq =-1;
+	int PageSize =10000;
+	int FeedLimit =100000;
+	bool bStarted =false;
+
+	bool
+	loadIndexes(QHash<QString, Index> &indexes, QString &primaryName);
+	QVariantList
+	key(const Index &index, const QVariantList &tuple, const bool bUnique =true) const;
+	void
+	apply(const QList<CHANGE> &changes);
+	void
+	put(QHash<QString, Index> &indexes, const QString &primaryName, const QVariantList &tuple);
+	void
+	remove(QHash<QString, Index> &indexes, const QString &primaryName, const QVariantList &tuple);
+
+signals:
+	void signalSynced(const qint64 sequence);
+};
+
+}
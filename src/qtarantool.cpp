@@ -6,16 +6,645 @@
  * 22.07.2022 🄯 JML
 ******************************************************************/
 #include "qtarantool.h"
+#include "lib/qmsgpack/private/unpack_p.h"
+#include "lib/qmsgpack/private/pack_p.h"
+
+#include <QThreadPool>
+#include <cerrno>
+#include <cstdlib>
+#include <algorithm>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QUuid>
+#include <QRegularExpression>
+#include <QFile>
 
 using namespace QTNT;
+
+namespace {
+
+const int BATCH_MIN_BYTES =4 * 1024; // adaptive setData(): the budget is never halved below
+const int PROTOCOL_VERSION =3; // IPROTO_VERSION of the client (2.10: watchers)
+const int FEED_POLL_INTERVAL =500; // ms, subscribe() to the server without watchers
+// marks QTarantool waiting for the reply: the socket data is left to receive()
+class BusyGuard
+{
+public:
+	BusyGuard(bool &flag) : flag(flag), old(flag) { flag =true; }
+	~BusyGuard() { flag =old; }
+
+private:
+	bool &flag;
+	const bool old;
+};
+// IPROTO_EVENT: <size> {IPROTO_REQUEST_TYPE: IPROTO_EVENT, IPROTO_SYNC: 0}, replies have the status there
+inline bool
+is_event(const QByteArray &packet)
+{
+	return(packet.size() > 7 && (quint8(packet[5]) & 0xf0) == 0x80 && packet[6] == IPROTO_REQUEST_TYPE && packet[7] == IPROTO_EVENT);
+}
+// IPROTO_SYNC of the raw packet <size><header>..., 0 - none
+quint64
+packet_sync(const QByteArray &packet)
+{
+quint8 *begin =reinterpret_cast<quint8 *>(const_cast<char *>(packet.constData()));
+const quint8 *end =begin + packet.size();
+quint8 *p =MsgPackPrivate::skip(begin, end); // <size>
+quint32 len =0;
+bool isMap =false;
+
+	if(p)
+		p =MsgPackPrivate::unpack_container_len(p, end, len, isMap);
+
+	for(quint32 c =0; c < len && p && isMap && p < end; c++)
+	{
+		if(*p == IPROTO_SYNC && p + 1 < end)
+		{
+		const quint8 *v =p + 1;
+
+			if(*v < 0x80) // positive fixint
+				return(*v);
+
+			if(*v == 0xCC && v + 2 <= end)
+				return(v[1]);
+
+			if(*v == 0xCD && v + 3 <= end)
+				return(qFromBigEndian<quint16>(v + 1));
+
+			if(*v == 0xCE && v + 5 <= end)
+				return(qFromBigEndian<quint32>(v + 1));
+
+			if(*v == 0xCF && v + 9 <= end)
+				return(qFromBigEndian<quint64>(v + 1));
+
+		return(0);
+		}
+
+		p =MsgPackPrivate::skip(p, end); // key
+
+		if(p)
+			p =MsgPackPrivate::skip(p, end); // value
+	}
+
+return(0);
+}
+// row of the snapshot stream: request type, space id and the tuple raw (not decoded)
+bool
+snapshot_row(const QByteArray &packet, int &type, uint &spaceId, QByteArray &tuple)
+{
+quint8 *begin =reinterpret_cast<quint8 *>(const_cast<char *>(packet.constData()));
+const quint8 *end =begin + packet.size();
+quint8 *p =MsgPackPrivate::skip(begin, end); // <size>
+quint32 len =0;
+bool isMap =false;
+
+	type =-1;
+	spaceId =0;
+	tuple.clear();
+
+	for(int part =0; part < 2 && p && p < end; part++) // <header>, <body>
+	{
+		p =MsgPackPrivate::unpack_container_len(p, end, len, isMap);
+
+		if(!p || !isMap)
+			return(false);
+
+		for(quint32 c =0; c < len; c++)
+		{
+		const quint8 key =*p; // IPROTO keys are positive fixint
+		quint8 *value =MsgPackPrivate::skip(p, end);
+		quint8 *next =(value ? MsgPackPrivate::skip(value, end) : nullptr);
+
+			if(!next)
+				return(false);
+
+		const QByteArray raw =QByteArray::fromRawData(reinterpret_cast<const char *>(value), static_cast<int>(next - value));
+
+			if(part == 0 && key == IPROTO_REQUEST_TYPE)
+				type =MsgPack::unpack(raw).toInt();
+			else
+			if(part == 1 && key == IPROTO_SPACE_ID)
+				spaceId =MsgPack::unpack(raw).toUInt();
+			else
+			if(part == 1 && key == IPROTO_TUPLE)
+				tuple =raw;
+
+			p =next;
+		}
+	}
+
+return(type >= 0);
+}
+// change feed of the space: on_replace trigger logs committed changes {old, new} by sequence number
+// (last 'limit'), returns the cursor of the consumer - it is kept if the log still reaches back
+const char *FEED_INSTALL =
+	"local sp, limit, consumer = ...;"
+	"qtnt_feeds = qtnt_feeds or {};"
+	"local feed = qtnt_feeds[sp];"
+	"if feed == nil then"
+	"	feed = {seq = 0, first = 1, log = {}, cursors = {}, limit = limit};"
+	"	local key = 'qtnt.feed.' .. sp;"
+	"	feed.trigger = function(old, new)"
+	"		box.on_commit(function()"
+	"			feed.seq = feed.seq + 1;"
+	"			feed.log[feed.seq] = {old or box.NULL, new or box.NULL};"
+	"			while feed.seq - feed.first + 1 > feed.limit do"
+	"				feed.log[feed.first] = nil; feed.first = feed.first + 1 end;"
+	"			if box.broadcast then box.broadcast(key, feed.seq) end end) end;"
+	"	box.space[sp]:on_replace(feed.trigger);"
+	"	qtnt_feeds[sp] = feed end;"
+	"feed.limit = math.max(feed.limit, limit);"
+	"local c = feed.cursors[consumer];"
+	"if c == nil or c + 1 < feed.first or c > feed.seq then c = feed.seq; feed.cursors[consumer] = c end;"
+	"return c";
+// acknowledges 'ack' and returns the next changes, the log is trimmed up to the slowest consumer,
+// null - the log does not reach back (or the feed is new)
+const char *FEED_FETCH =
+	"local sp, consumer, ack, max = ...;"
+	"local feed = qtnt_feeds and qtnt_feeds[sp];"
+	"if feed == nil or ack + 1 < feed.first or ack > feed.seq then return box.NULL end;"
+	"feed.cursors[consumer] = ack;"
+	"local low = ack;"
+	"for _, c in pairs(feed.cursors) do low = math.min(low, c) end;"
+	"while feed.first <= low do feed.log[feed.first] = nil; feed.first = feed.first + 1 end;"
+	"local r = {};"
+	"for i = ack + 1, math.min(feed.seq, ack + max) do r[#r + 1] = feed.log[i] end;"
+	"return feed.seq, r";
+const char *FEED_LEAVE =
+	"local sp, consumer = ...;"
+	"local feed = qtnt_feeds and qtnt_feeds[sp];"
+	"if feed ~= nil then feed.cursors[consumer] = nil end";
+// encodes EVAL body of one batch of setDataPipelined(), the body is released into the pool
+// of the caller thread: the thread pool worker packs it without its own pool
+class EncodeTask : public QRunnable
+{
+public:
+	EncodeTask(const QString &lua, const QVariantList &tuples, QByteArray &out, qint64 &nsecs, QSemaphore &ready) :
+		lua(lua), tuples(tuples), out(out), nsecs(nsecs), ready(ready) { }
+
+	void
+	run() override
+	{
+	QElapsedTimer tmr;
+	QUIntMap body;
+
+		tmr.start();
+		body[IPROTO_EXPR] =lua;
+		body[IPROTO_TUPLE] =tuples;
+		out =MsgPack::pack(body);
+		nsecs =tmr.nsecsElapsed();
+		ready.release();
+	}
+
+private:
+	const QString lua;
+	const QVariantList tuples;
+	QByteArray &out;
+	qint64 &nsecs;
+	QSemaphore &ready;
+};
+
+/****************************************************************************************
+ * Recursive descent parser of the IndexKey text: {<value>, ...}, outer braces are optional.
+ * <value>: "string" | 'string' | true | false | <integer> | <float> | {<value>, ...}
+ * Nothing is allocated except the values of the key.
+****************************************************************************************/
+class KeyParser
+{
+public:
+	KeyParser(const QString &text) : begin(text.constData()), p(begin), end(begin + text.size()) { }
+
+	bool
+	parse(QVariantList &key)
+	{
+		ws();
+
+		if(p < end && *p == '{')
+		{
+			if(!list(key))
+				return(false);
+		}
+		else
+		if(!items(key, QChar()))
+			return(false);
+
+		ws();
+
+	return(p == end); // garbage after the key
+	}
+
+	inline int
+	position() const { return(static_cast<int>(p - begin)); }
+
+private:
+	const QChar *begin;
+	const QChar *p;
+	const QChar *end;
+
+	inline void
+	ws() { while(p < end && p->isSpace()) p++; }
+
+	bool
+	list(QVariantList &out)
+	{
+		p++; // '{'
+
+		if(!items(out, '}'))
+			return(false);
+
+		p++; // '}'
+
+	return(true);
+	}
+	// items up to 'close' (not consumed), null 'close' - up to the end of the text
+	bool
+	items(QVariantList &out, const QChar close)
+	{
+		ws();
+
+		if(p < end && *p == close)
+			return(true);
+
+		if(p == end)
+			return(close.isNull());
+
+		for(;;)
+		{
+		QVariant v;
+
+			ws();
+
+			if(!value(v))
+				return(false);
+
+			out.append(v);
+			ws();
+
+			if(p == end)
+				return(close.isNull());
+
+			if(*p == close)
+				return(true);
+
+			if(*p != ',')
+				return(false);
+
+			p++;
+		}
+	}
+
+	bool
+	value(QVariant &v)
+	{
+		if(p == end)
+			return(false);
+
+	const QChar c =*p;
+
+		if(c == '"' || c == '\'')
+		{
+		const QChar *open =p++;
+
+			while(p < end && *p != c)
+				p++;
+
+			if(p == end) // unclosed string
+			{
+				p =open;
+
+			return(false);
+			}
+
+			v =QString(open + 1, static_cast<int>(p - open - 1));
+			p++;
+
+		return(true);
+		}
+
+		if(c == '{')
+		{
+		QVariantList nested;
+
+			if(!list(nested))
+				return(false);
+
+			v =nested;
+
+		return(true);
+		}
+
+		if(word("true"))
+			v =true;
+		else
+		if(word("false"))
+			v =false;
+		else
+			return(number(v));
+
+	return(true);
+	}
+	// case-insensitive keyword
+	bool
+	word(const char *w)
+	{
+	const QChar *q =p;
+
+		for(; *w; w++, q++)
+			if(q == end || q->toLower() != QLatin1Char(*w))
+				return(false);
+
+		p =q;
+
+	return(true);
+	}
+
+	bool
+	number(QVariant &v)
+	{
+	char buf[64];
+	int n =0;
+	bool isInteger =true;
+
+		if(p < end && (*p == '-' || *p == '+'))
+			buf[n++] =p++->toLatin1();
+
+	const QChar *digits =p;
+
+		while(p < end && n < (int)sizeof(buf) - 1)
+		{
+		const char ch =p->toLatin1();
+
+			if(ch >= '0' && ch <= '9')
+				buf[n++] =ch;
+			else
+			if(ch == '.' || ch == 'e' || ch == 'E' || ((ch == '-' || ch == '+') && n && (buf[n - 1] == 'e' || buf[n - 1] == 'E')))
+			{
+				buf[n++] =ch;
+				isInteger =false;
+			}
+			else
+				break;
+
+			p++;
+		}
+
+		buf[n] ='\0';
+
+		if(p == digits) // no number
+			return(false);
+
+	char *tail =nullptr;
+
+		errno =0;
+
+		if(isInteger)
+		{
+		const qlonglong i =strtoll(buf, &tail, 10);
+
+			if(!errno)
+			{
+				v =i;
+
+			return(true);
+			}
+		}
+
+	bool ok =false;
+	const double d =QByteArray::fromRawData(buf, n).toDouble(&ok); // not strtod(): it follows LC_NUMERIC (e.g. ',' in ru_RU)
+
+		if(!ok) // malformed float: the error is after the longest valid prefix
+		{
+		int valid =n - 1;
+
+			for(; valid > 0; valid--)
+			{
+				QByteArray::fromRawData(buf, valid).toDouble(&ok);
+
+				if(ok)
+					break;
+			}
+
+			p -=(n - valid);
+
+		return(false);
+		}
+
+		v =d;
+
+	return(true);
+	}
+};
+
+// field number or name as Lua literal
+QString
+luaField(const QVariant &field)
+{
+	if(field.type() == QVariant::String)
+		return(QString(field.toString()).replace('\\', "\\\\").replace('\'', "\\'").prepend('\'').append('\''));
+
+return(QString::number(field.toUInt()));
+}
+
+} // namespace
+/****************************************************************************************
+ *									IndexKey text
+****************************************************************************************/
+IndexKey
+IndexKey::parse(const QString &text, int *errorPos)
+{
+IndexKey key;
+KeyParser parser(text);
+
+	if(!parser.parse(key))
+	{
+		key.clear();
+		key.IsValid =false;
+	}
+
+	if(errorPos)
+		*errorPos =(key.IsValid ? -1 : parser.position());
+
+return(key);
+}
+/****************************************************************************************
+ *									IndexKey encoding
+****************************************************************************************/
+IndexKey
+IndexKey::fromInt(const qint64 id)
+{
+IndexKey key {QVariant(id)};
+
+	key.Inline[0] =MsgPack::FirstByte::FIXARRAY | 1;
+	key.InlineSize =static_cast<quint8>(MsgPackPrivate::pack_longlong(id, key.Inline + 1, true) - key.Inline);
+	key.EncodedList =key;
+
+return(key);
+}
+
+IndexKey
+IndexKey::fromStr(const QString &id)
+{
+IndexKey key {QVariant(id)};
+
+	key.Encoded =(MsgPack::TupleBuilder(id.size() * 3 + 8) << id).build().Data;
+	key.EncodedList =key;
+
+return(key);
+}
+
+IndexKey
+IndexKey::encoded(const IndexKey &key)
+{
+	if(key.isEncoded())
+		return(key);
+
+IndexKey k(key);
+
+	k.InlineSize =0;
+	k.Encoded =MsgPack::pack(static_cast<const QVariantList &>(key));
+	k.EncodedList =k;
+
+return(k);
+}
+
+QByteArray
+IndexKey::encoding() const
+{
+	if(isEncoded()) // own copy: the key can be destroyed before the encoding
+		return(InlineSize ? QByteArray(reinterpret_cast<const char *>(Inline), InlineSize) : Encoded);
+
+return(MsgPack::pack(static_cast<const QVariantList &>(*this)));
+}
+/****************************************************************************************
+ *									Predicate
+****************************************************************************************/
+Predicate
+Predicate::compare(const QVariant &field, const char *op, const QVariant &value)
+{
+Predicate p;
+
+	p.Type =Compare;
+	p.Field =field;
+	p.Op =op;
+	p.Value =value;
+
+return(p);
+}
+
+Predicate
+Predicate::in(const QVariant &field, const QVariantList &values)
+{
+Predicate p;
+
+	p.Type =InList;
+	p.Field =field;
+	p.Value =values;
+
+return(p);
+}
+
+Predicate
+Predicate::prefix(const QVariant &field, const QString &prefix)
+{
+Predicate p;
+
+	p.Type =Prefix;
+	p.Field =field;
+	p.Value =prefix;
+
+return(p);
+}
+
+Predicate
+Predicate::isNull(const QVariant &field)
+{
+Predicate p;
+
+	p.Type =IsNull;
+	p.Field =field;
+
+return(p);
+}
+
+Predicate
+Predicate::join(const Kind type, const Predicate &p) const
+{
+	if(Type == Always) // 'any' && p == p
+		return(type == And ? p : *this);
+
+	if(p.Type == Always)
+		return(type == And ? *this : p);
+
+Predicate j;
+
+	j.Type =type;
+	j.Operands ={*this, p};
+
+return(j);
+}
+
+Predicate
+Predicate::operator!() const
+{
+Predicate p;
+
+	p.Type =Not;
+	p.Operands ={*this};
+
+return(p);
+}
+/****************************************************************************************
+ * Values are not the part of the expression, so predicates of the same shape
+ * give the same text and share one server function.
+****************************************************************************************/
+QString
+Predicate::compile(QVariantList &params, QString &prologue) const
+{
+const QString field =QString("t[%1]").arg(luaField(Field));
+const QString n =QString::number(params.size() + 1); // number of the next parameter
+
+	switch(Type)
+	{
+	case Compare:
+		params.append(Value);
+		return(QString("(%1 ~= nil and %1 %2 p[%3])").arg(field, Op, n));
+	case InList:
+		params.append(Value);
+		prologue +=QString("local s%1 ={}; for _, v in ipairs(p[%1]) do s%1[v] =true end;").arg(n);
+		return(QString("(%1 ~= nil and s%2[%1] ~= nil)").arg(field, n));
+	case Prefix:
+		params.append(Value);
+		return(QString("(type(%1) == 'string' and %1:sub(1, #p[%2]) == p[%2])").arg(field, n));
+	case IsNull:
+		return(QString("(%1 == nil)").arg(field));
+	case And:
+	case Or:
+	{
+	const QString left =Operands[0].compile(params, prologue);
+
+		return(QString("(%1 %2 %3)").arg(left, Type == And ? "and" : "or", Operands[1].compile(params, prologue)));
+	}
+	case Not:
+		return(QString("(not %1)").arg(Operands[0].compile(params, prologue)));
+	default:
+		return("true");
+	}
+}
 //----------------------------------------------------------------------------------------
-QTarantool::QTarantool(QObject *parent) : QThread(parent)
+QTarantool::QTarantool(QObject *parent) : QThread(parent), FeedTimer(this)
 {
 	socket = new QUnSocket(this);
 	//socket->setSocketOption(QTcpSocket::ReceiveBufferSizeSocketOption, 10000000);
 
 	connect(socket, &QUnSocket::connected, this, &QTarantool::on_SocketConnected); // [QT-NOTE] Qt::QueuedConnection required qRegisterMetaType()
 	connect(socket, &QUnSocket::disconnected, this, &QTarantool::on_SocketDisconnected);
+	connect(socket, &QUnSocket::readyRead, this, &QTarantool::on_SocketReadyRead);
+
+	connect(&FeedTimer, &QTimer::timeout, this, [this] {
+
+		for(const auto &spaceName : Subscriptions.keys())
+			pollFeed(spaceName);
+	});
 
 #if QT_VERSION > QT_VERSION_CHECK(5, 15, 0)
 	connect(socket, &QUnSocket::errorOccurred, this, &QTarantool::on_SocketError);
@@ -32,6 +661,8 @@ QTarantool::connectToServer(const QString &uri)
 	if(!socket->connectToServer(uri, TIMEOUT))
 		return(false);
 
+BusyGuard busy(bBusy);
+
 	if(socket->waitForReadyRead(TIMEOUT))
 	{
 	QByteArray baReply(socket->readAll());
@@ -42,6 +673,30 @@ QTarantool::connectToServer(const QString &uri)
 			version =slReply.at(0);
 			salt =QByteArray::fromBase64(slReply.at(1));
 			bInit =true;
+			identify();
+
+			if(hasFeature(FEATURE_WATCHERS))
+			{
+				FeedTimer.stop();
+
+				for(const auto &key : Watches.keys()) // the server forgets them with the session
+					postWatch(IPROTO_WATCH, key);
+			}
+			else
+			{
+				for(const auto &spaceName : Caches.keys()) // would not be invalidated
+					disableCache(spaceName);
+
+				if(Subscriptions.size())
+					FeedTimer.start(FEED_POLL_INTERVAL);
+			}
+			// the feed key of a restarted server has no value yet: no event would poll the lost feed
+			if(Subscriptions.size())
+				QMetaObject::invokeMethod(this, [this] {
+
+					for(const auto &spaceName : Subscriptions.keys())
+						pollFeed(spaceName);
+				}, Qt::QueuedConnection);
 
 			emit signalConnected(isConnected() & bInit);
 		}
@@ -61,6 +716,13 @@ QTarantool::disconnectServer()
 		socket->close();
 
 	UserName ="";
+	RxBuffer.clear();
+	SpaceFormats.clear();
+	Predicates.clear();
+	bReplicating =false;
+
+	for(auto &cache : Caches) // changes are not watched without the connection
+		cache->clear();
 }
 /****************************************************************************************
  *
@@ -78,14 +740,14 @@ return("");
 /****************************************************************************************
  * Send ping to server
  * Return: Measured ping time in nanoseconds.
- *		   0 (zero) if timeout.
+ *		   0 (zero) if timeout (or while replicate()).
 ****************************************************************************************/
 qint64
 QTarantool::ping()
 {
 QUIntMap hdr;
 
-	if(!isConnected())
+	if(!isConnected() || bReplicating) // receive() would take a row for the reply
 		return(0);
 
 	hdr[IPROTO_REQUEST_TYPE] =IPROTO_PING;
@@ -109,7 +771,7 @@ qint64 nsec;
 	if(tmr.hasExpired(TIMEOUT)) // TIMEOUT in mSec (miliseconds)
 		return(0);
 
-	socket->readAll(); // clear socket buffer
+	MsgPack::BufferPool::release(receive(hdr[IPROTO_SYNC].toULongLong())); // the pong
 
 return(nsec); // result in nSec (nanoseconds)
 }
@@ -371,7 +1033,9 @@ return("");
 bool
 QTarantool::changeSpace(const QString &spaceName, const QStringList &newParams)
 {
-	return(exec(tr("box.space['%1']:alter({%2})").arg(spaceName).arg(newParams.join(','))).IsValid);
+	SpaceFormats.remove(spaceName);
+
+return(exec(tr("box.space['%1']:alter({%2})").arg(spaceName).arg(newParams.join(','))).IsValid);
 }
 /****************************************************************************************
  * Return: true if successful delete data of Space[<name>] otherwise false.
@@ -387,7 +1051,9 @@ QTarantool::clearSpace(const QString &spaceName)
 bool
 QTarantool::deleteSpace(const QString &spaceName)
 {
-	return(exec("box.space[...]:drop()", {spaceName}).IsValid);
+	SpaceFormats.remove(spaceName);
+
+return(exec("box.space[...]:drop()", {spaceName}).IsValid);
 }
 /****************************************************************************************
  *
@@ -406,59 +1072,395 @@ return(false);
  * Return: list of tuples
 ****************************************************************************************/
 const QVariantList &
-QTarantool::getData(const QString &spaceName, const Selector &selectorFrom, const Selector &selectorTo, const uint limit)
+QTarantool::getData(const QString &spaceName, const Selector &selectorFrom, const Selector &selectorTo, const uint limit, const QVariantList &fields)
 {
-bool fwd =false;
-
-	if(selectorTo.Operator) // if !ALL
-		if((selectorFrom.Operator < LE && selectorTo.Operator < LE) || (selectorFrom.Operator >= LE && selectorTo.Operator >= LE))
-			return(LISTNULL); // unidirectional selectors
-		else
-		if(selectorFrom.Operator < LE)
-			fwd =true; // forward
-
-QString lua(tr("local idx =box.space['%1'].index['%2'];").arg(spaceName).arg(selectorFrom.IndexName));
+const QSharedPointer<TupleCache> cache =(selectorFrom.Operator == EQ && selectorTo.Operator == ALL && selectorFrom.IndexName == "primary"
+										 && fields.isEmpty() && limit ? Caches.value(spaceName) : QSharedPointer<TupleCache>());
+const QByteArray cacheKey =(cache ? selectorFrom.Key.encoding() : QByteArray());
+const quint64 generation =(cache ? cache->generation() : 0);
 
-	lua +=tr("local result =idx:pairs(%1,{iterator='%2'});").arg(selectorFrom.Key.text()).arg(ToStr(selectorFrom.Operator));
+	if(cache && cache->find(cacheKey, CacheResult))
+		return(CacheResult); // no request
 
-	if(selectorTo.Operator) // if !ALL
-	{
-		lua +=tr("local k =require('key_def').new(idx.parts);"
-				 "local stop =idx:select(%1, {iterator='%2'})[1];").arg(selectorTo.Key.text()).arg(ToStr(selectorTo.Operator));
-		lua +=tr("result =result:take_while(function(t) return k:compare(t, stop) %1 0 end);").arg(fwd ? "<=" : ">=");
-	}
+const QString lua =selectScript(spaceName, selectorFrom, selectorTo, limit, fields);
 
-	lua +=tr("return result:take(%1):totable();").arg(limit);
+	if(lua.isEmpty())
+		return(LISTNULL); // unidirectional selectors
 
 	exec(lua);
 
 const auto &DataList =reinterpret_cast<const QVariantList &>(Reply.Data[IPROTO_DATA]);
 
 	if(Reply.IsValid)
-		return(reinterpret_cast<const QVariantList &>(DataList[0]));
+	{
+		if(cache)
+			cache->insert(cacheKey, DataList[0].toList(), generation);
+
+	return(reinterpret_cast<const QVariantList &>(DataList[0]));
+	}
 
 return(LISTNULL);
 }
 /****************************************************************************************
- * Get field of tuple
-- Fields are numbered from 1
-- Accessing a field that does not exist does NOT cause an ERROR [TNT-Note]
-- 'field' number are only positive
+ * Same selection as getData(), but the reply is decoded into the arena-backed document.
+ * Return: array of tuples. The value is valid until the next request to the server.
 ****************************************************************************************/
-const QVariant &
-QTarantool::getData(const QString &spaceName, const IndexKey &key, const uint field, const QString &indexName)
+MsgPack::Document::Value
+QTarantool::getDocument(const QString &spaceName, const Selector &selectorFrom, const Selector &selectorTo, const uint limit, const QVariantList &fields)
 {
-	if(indexName.isEmpty())
-		exec(tr("return box.space['%1']:get(...)[%2]").arg(spaceName).arg(field), key);
-	else
-		exec(tr("return box.space['%1'].index['%2']:get(...)[%3]").arg(spaceName).arg(indexName).arg(field), key);
-
-const auto &DataList =reinterpret_cast<const QVariantList &>(Reply.Data[IPROTO_DATA]);
+const QString lua =selectScript(spaceName, selectorFrom, selectorTo, limit, fields);
 
-	if(Reply.IsValid)
-		return(reinterpret_cast<const QVariant &>(DataList[0]));
+	if(lua.isEmpty())
+		return({}); // unidirectional selectors
 
-return(VARNULL);
+return(execDocument(lua)[2][IPROTO_DATA][0]);
+}
+/****************************************************************************************
+ * Same selection as getData(), but tuples are decoded directly into typed columns
+ * (struct of arrays) by the cached format of the Space. Fields beyond the format are skipped.
+ * Return: empty columns on error or if the Space has no format.
+****************************************************************************************/
+MsgPack::Columns
+QTarantool::getColumns(const QString &spaceName, const Selector &selectorFrom, const Selector &selectorTo, const uint limit, const QVariantList &fields)
+{
+const QString lua =selectScript(spaceName, selectorFrom, selectorTo, limit, fields);
+
+	if(lua.isEmpty())
+		return(COLUMNSNULL); // unidirectional selectors
+
+MsgPack::Columns columns =spaceFormat(spaceName);
+
+	if(!columns.count())
+		return(COLUMNSNULL);
+
+	if(fields.size()) // columns of the projection only
+	{
+	QVector<MsgPack::Columns::Type> types;
+	QStringList names;
+
+		for(const auto &f : fields)
+		{
+		const int c =(f.type() == QVariant::String ? columns.indexOf(f.toString()) : static_cast<int>(f.toUInt()) - 1);
+
+			types.append(c >= 0 && c < columns.count() ? columns[c].DataType : MsgPack::Columns::Variant);
+			names.append(c >= 0 && c < columns.count() ? columns[c].Name : f.toString());
+		}
+
+		columns.setFormat(types, names);
+	}
+
+QByteArray packet;
+const int offset =execRaw(lua, packet); // <tuples>
+
+	if(offset < 0)
+		return(COLUMNSNULL);
+
+	if(!columns.decode(packet, offset))
+	{
+		setLastError({-1, "Malformed server response."});
+
+	return(COLUMNSNULL);
+	}
+
+return(columns);
+}
+/****************************************************************************************
+ * Same selection as getData(), but tuples are transcoded from the reply directly into JSON text.
+ * Return: JSON array of tuples, or empty array on error.
+****************************************************************************************/
+QByteArray
+QTarantool::getJson(const QString &spaceName, const Selector &selectorFrom, const Selector &selectorTo, const uint limit, const QVariantList &fields)
+{
+const QString lua =selectScript(spaceName, selectorFrom, selectorTo, limit, fields);
+
+	if(lua.isEmpty())
+		return(QByteArray()); // unidirectional selectors
+
+QByteArray packet;
+const int offset =execRaw(lua, packet); // <tuples>
+bool ok =false;
+
+	if(offset < 0)
+		return(QByteArray());
+
+const QByteArray json =MsgPack::toJson(packet, offset, &ok);
+
+	if(!ok)
+		setLastError({-1, "Malformed server response."});
+
+return(json);
+}
+/****************************************************************************************
+ * Computes aggregates over the selection (same range semantics as getData()) on the server,
+ * only the results are transferred.
+ * 'count' - quantity of tuples, 'sum'/'min'/'max'/'avg' - over non-null values of the field.
+ * Return: list of results in the order of 'aggregates', null - no values,
+ * empty list - error (e.g. unknown function, checked before the request).
+****************************************************************************************/
+const QVariantList &
+QTarantool::aggregate(const QString &spaceName, const Selector &selectorFrom, const Selector &selectorTo, const QList<Aggregate> &aggregates)
+{
+QString lua =selectIterator(spaceName, selectorFrom, selectorTo);
+
+	if(lua.isEmpty()) // unidirectional selectors
+		return(LISTNULL);
+
+	if(aggregates.isEmpty()) // nothing to compute
+		return(LISTNULL);
+
+QStringList ops, fields;
+
+	for(const auto &a : aggregates)
+	{
+	const QString op =a.Function.toLower();
+
+		if(op != "count" && op != "sum" && op != "min" && op != "max" && op != "avg") // the name goes into the Lua text
+		{
+			setLastError({-1, tr("Unknown aggregate function '%1'.").arg(a.Function)});
+
+		return(LISTNULL);
+		}
+
+		ops.append(tr("'%1'").arg(op));
+		fields.append(luaField(a.Field));
+	}
+
+	lua +=tr("local ops, fl ={%1}, {%2};").arg(ops.join(',')).arg(fields.join(','));
+	lua +=	"local acc, cnt ={}, {};"
+			"result:each(function(t)"
+			"	for i = 1, #ops do"
+			"		local op =ops[i];"
+			"		if op == 'count' then cnt[i] =(cnt[i] or 0) + 1;"
+			"		else"
+			"			local v =t[fl[i]];"
+			"			if v ~= nil then"
+			"				cnt[i] =(cnt[i] or 0) + 1;"
+			"				if op == 'sum' or op == 'avg' then acc[i] =(acc[i] or 0) + v;"
+			"				elseif op == 'min' then if acc[i] == nil or v < acc[i] then acc[i] =v end;"
+			"				elseif op == 'max' then if acc[i] == nil or v > acc[i] then acc[i] =v end end end end end end);"
+			"local r ={};"
+			"for i = 1, #ops do"
+			"	if ops[i] == 'count' then r[i] =cnt[i] or 0;"
+			"	elseif acc[i] == nil then r[i] =box.NULL;"
+			"	elseif ops[i] == 'avg' then r[i] =acc[i] / cnt[i];"
+			"	else r[i] =acc[i] end end;"
+			"return r";
+
+	exec(lua);
+
+const auto &DataList =reinterpret_cast<const QVariantList &>(Reply.Data[IPROTO_DATA]);
+
+	if(Reply.IsValid)
+		return(reinterpret_cast<const QVariantList &>(DataList[0]));
+
+return(LISTNULL);
+}
+/****************************************************************************************
+ * Lua-code of the selection iterator 'result' (luafun) over the range of selectors.
+ * Return: empty string if selectors are unidirectional.
+****************************************************************************************/
+QString
+QTarantool::selectIterator(const QString &spaceName, const Selector &selectorFrom, const Selector &selectorTo)
+{
+bool fwd =false;
+
+	if(selectorTo.Operator) // if !ALL
+		if((selectorFrom.Operator < LE && selectorTo.Operator < LE) || (selectorFrom.Operator >= LE && selectorTo.Operator >= LE))
+			return(""); // unidirectional selectors
+		else
+		if(selectorFrom.Operator < LE)
+			fwd =true; // forward
+
+QString lua(tr("local idx =box.space['%1'].index['%2'];").arg(spaceName).arg(selectorFrom.IndexName));
+
+	lua +=tr("local result =idx:pairs(%1,{iterator='%2'});").arg(selectorFrom.Key.text()).arg(ToStr(selectorFrom.Operator));
+
+	if(selectorTo.Operator) // if !ALL
+	{
+		lua +=tr("local k =require('key_def').new(idx.parts);"
+				 "local stop =idx:select(%1, {iterator='%2'})[1];").arg(selectorTo.Key.text()).arg(ToStr(selectorTo.Operator));
+		lua +=tr("result =result:take_while(function(t) return k:compare(t, stop) %1 0 end);").arg(fwd ? "<=" : ">=");
+	}
+
+return(lua);
+}
+/****************************************************************************************
+ * Lua-script of tuples selection for getData() methods.
+ * Return: empty string if selectors are unidirectional.
+****************************************************************************************/
+QString
+QTarantool::selectScript(const QString &spaceName, const Selector &selectorFrom, const Selector &selectorTo, const uint limit, const QVariantList &fields)
+{
+QString lua =selectIterator(spaceName, selectorFrom, selectorTo);
+
+	if(lua.isEmpty())
+		return(""); // unidirectional selectors
+
+	if(fields.size()) // projection on the server, missing field - null
+	{
+	QStringList p;
+
+		for(const auto &f : fields)
+			p.append(luaField(f));
+
+		lua +=tr("local p ={%1};"
+				 "result =result:map(function(t)"
+				 "	local r ={};"
+				 "	for i = 1, #p do"
+				 "		local v =t[p[i]];"
+				 "		if v == nil then v =box.NULL end;"
+				 "		r[i] =v end;"
+				 "	return r end);").arg(p.join(','));
+	}
+
+	lua +=tr("return result:take(%1):totable();").arg(limit);
+
+return(lua);
+}
+/****************************************************************************************
+ * Get field of tuple
+- Fields are numbered from 1
+- Accessing a field that does not exist does NOT cause an ERROR [TNT-Note]
+- 'field' number are only positive
+****************************************************************************************/
+const QVariant &
+QTarantool::getData(const QString &spaceName, const IndexKey &key, const uint field, const QString &indexName)
+{
+MsgPack::Builder args(64);
+
+	args.beginArray() << spaceName;
+
+	if(indexName.isEmpty())
+		args.addNull();
+	else
+		args << indexName;
+
+	args << field << MsgPack::Packed::fromData(key.encoding());
+	execEncoded(QByteArrayLiteral("local sp, ix, f, k =...;"
+								  "local s =box.space[sp];"
+								  "return (ix and s.index[ix] or s):get(k)[f]"), args.build().Data); // constant script, no formatting
+
+const auto &DataList =reinterpret_cast<const QVariantList &>(Reply.Data[IPROTO_DATA]);
+
+	if(Reply.IsValid)
+		return(reinterpret_cast<const QVariant &>(DataList[0]));
+
+return(VARNULL);
+}
+/****************************************************************************************
+ * Gets tuples by many keys in one round trip (any unique index).
+ * 'fields' - projection of tuples (numbered from 1), empty - whole tuples.
+ * Return: list in the order of 'keys', a missing tuple is null QVariant.
+****************************************************************************************/
+const QVariantList &
+QTarantool::getMany(const QString &spaceName, const QList<IndexKey> &keys, const QList<uint> &fields, const QString &indexName)
+{
+	if(keys.isEmpty())
+		return(LISTNULL);
+
+MsgPack::Builder args(64 + keys.size() * 16);
+
+	args.beginArray() << spaceName;
+
+	if(indexName.isEmpty())
+		args.addNull();
+	else
+		args << indexName;
+
+	args.beginArray();
+
+	for(const auto &key : keys)
+		args << MsgPack::Packed::fromData(key.encoding());
+
+	args.end();
+
+	if(fields.isEmpty())
+		args.addNull();
+	else
+	{
+		args.beginArray();
+
+		for(const auto f : fields)
+			args << f;
+
+		args.end();
+	}
+
+	execEncoded(QByteArrayLiteral("local sp, ix, keys, fields =...;"
+								  "local s =box.space[sp];"
+								  "local idx =(ix and s.index[ix] or s.index[0]);"
+								  "local r ={};"
+								  "for i = 1, #keys do"
+								  "	local t =idx:get(keys[i]);"
+								  "	if t == nil then r[i] =box.NULL;"
+								  "	elseif fields then"
+								  "		local p ={};"
+								  "		for j = 1, #fields do"
+								  "			local v =t[fields[j]];"
+								  "			if v == nil then v =box.NULL end;"
+								  "			p[j] =v end;"
+								  "		r[i] =p;"
+								  "	else r[i] =t end end;"
+								  "return r"), args.build().Data);
+
+const auto &DataList =reinterpret_cast<const QVariantList &>(Reply.Data[IPROTO_DATA]);
+
+	if(Reply.IsValid)
+		return(reinterpret_cast<const QVariantList &>(DataList[0]));
+
+return(LISTNULL);
+}
+/****************************************************************************************
+ * Selects tuples by 'selectorFrom' and returns up to 'limit' of them matching 'predicate'.
+ * The predicate is checked on the server: its shape is compiled to a global server function
+ * once (cached by name until reconnect), the values are passed as call parameters.
+ * Requires 'execute' privilege on 'universe'.
+****************************************************************************************/
+const QVariantList &
+QTarantool::filter(const QString &spaceName, const Selector &selectorFrom, const Predicate &predicate, const uint limit)
+{
+QVariantList params;
+QString prologue;
+const QString expr =predicate.compile(params, prologue);
+const QString name ="qtnt_filter_" + QString::fromLatin1(SHA1((prologue + expr).toUtf8()).toHex().left(16));
+
+	for(int attempt =0; attempt < 2; attempt++)
+	{
+		if(!Predicates.contains(name))
+		{
+			exec(tr("rawset(_G, '%1', function(sp, ix, it, key, limit, p)"
+					"%2"
+					"local r, n ={}, 0;"
+					"if limit == 0 then return r end;"
+					"for _, t in box.space[sp].index[ix]:pairs(key, {iterator =it}) do"
+					"	if %3 then n =n + 1; r[n] =t; if n >= limit then break end end end;"
+					"return r end)").arg(name, prologue, expr));
+
+			if(!Reply.IsValid)
+				return(LISTNULL);
+
+			Predicates.insert(name);
+		}
+
+	MsgPack::Builder args(128);
+
+		args.beginArray() << spaceName << selectorFrom.IndexName << ToStr(selectorFrom.Operator)
+						  << MsgPack::Packed::fromData(selectorFrom.Key.encoding()) << limit << QVariant(params);
+
+		execEncoded(name.toUtf8(), args.build().Data, IPROTO_CALL);
+
+	const auto &DataList =reinterpret_cast<const QVariantList &>(Reply.Data[IPROTO_DATA]);
+
+		if(Reply.IsValid)
+			return(reinterpret_cast<const QVariantList &>(DataList[0]));
+
+		if(lasterror.code != 33) // ER_NO_SUCH_PROC : server was restarted - compile again
+			break;
+
+		Predicates.remove(name);
+	}
+
+return(LISTNULL);
 }
 /****************************************************************************************
  * Set new values for 1(one) tuple by primary index.
@@ -469,27 +1471,64 @@ bool
 QTarantool::setData(const QString &spaceName, const QVariantList &tuple, const bool bIfExist) // [FIXME] double values
 {
 	if(tuple.size())
-		if(!bIfExist)
-			return(exec(tr("box.space['%1']:replace{...}").arg(spaceName), tuple).IsValid);
-		else
-			return(exec(tr("local s =box.space['%1'];").arg(spaceName) +
-							"local t ={...};"
-							"if s:get(require('key_def').new(s.index[0].parts):extract_key(t)) then"
-							"	s:replace(t);"
-							"else error('Key not found.') end", tuple).IsValid);
+		return(exec(setScript(spaceName, bIfExist), tuple).IsValid);
+
 return(false);
 }
+/****************************************************************************************
+ * Lua-script of setData() for 1(one) tuple passed as arguments.
+****************************************************************************************/
+QString
+QTarantool::setScript(const QString &spaceName, const bool bIfExist)
+{
+	if(!bIfExist)
+		return(tr("box.space['%1']:replace{...}").arg(spaceName));
+
+return(tr("local s =box.space['%1'];").arg(spaceName) +
+		  "local t ={...};"
+		  "if s:get(require('key_def').new(s.index[0].parts):extract_key(t)) then"
+		  "	s:replace(t);"
+		  "else error('Key not found.') end");
+}
+/****************************************************************************************
+ * Lua-script of the batch setters: the tuples are the arguments,
+ * 'bArray' - the arguments are one array of the tuples (no limit of the Lua arguments count).
+****************************************************************************************/
+QString
+QTarantool::batchScript(const QString &spaceName, const bool bArray)
+{
+	return(tr("local tt =%1;"
+			  "for i = 1, #tt do"
+			  "	box.space['%2']:replace(tt[i]) end;").arg(bArray ? "..." : "{...}", spaceName));
+}
+/****************************************************************************************
+ * Same as setData(tuple, bIfExist), the fields are written by MsgPack::TupleBuilder
+ * and sent without QVariant and re-encoding. Not an overload of setData():
+ * a braced tuple {value} would be ambiguous with the builder.
+****************************************************************************************/
+bool
+QTarantool::setBuilt(const QString &spaceName, MsgPack::TupleBuilder &&tuple, const bool bIfExist)
+{
+const MsgPack::Packed packed =tuple.build();
+
+	if(packed.Data.size() <= 1) // empty array
+		return(false);
+
+return(execPacked(setScript(spaceName, bIfExist), packed.Data));
+}
 /****************************************************************************************
  * Set new values for tuples by primary index.
  * If the tuple from list 'tuples' did not exist it will be inserted as a new tuple.
+ * 'batchSize' BATCH_ADAPTIVE : see setDataAdaptive().
 ****************************************************************************************/
 bool
 QTarantool::setData(const QString &spaceName, const QList<QVariantList> &tuples, const int batchSize)
 {
+	if(batchSize <= BATCH_ADAPTIVE)
+		return(setDataAdaptive(spaceName, tuples));
+
 bool result =true;
-QString lua =tr("local tt ={...};"
-				"for i = 1, #tt do"
-				"	box.space['%1']:replace(tt[i]) end;").arg(spaceName);
+const QString lua =batchScript(spaceName);
 
 	for(auto it =tuples.begin(), it_end =it; it != tuples.end() && result; it =it_end)
 	{
@@ -500,247 +1539,1641 @@ QString lua =tr("local tt ={...};"
 return(result);
 }
 /****************************************************************************************
- * Insert new 1(one) tuple by primary index
- * If the tuple exists, method will return an error.
+ * Set tuples already encoded to msgpack as array of tuples (see MsgPack::fromJson()).
+ * The tuples are sent to the server as is, without re-encoding.
+ * If the tuple did not exist it will be inserted as a new tuple.
 ****************************************************************************************/
 bool
-QTarantool::insertData(const QString &spaceName, const QVariantList &tuple) // [FIXME] double values
+QTarantool::setData(const QString &spaceName, const MsgPack::Packed &tuples)
 {
-	if(tuple.size())
-		return(exec(tr("box.space['%1']:insert{...}").arg(spaceName), tuple).IsValid);
+	if(tuples.Data.isEmpty())
+		return(false);
 
-return(false);
+return(execPacked(batchScript(spaceName), tuples.Data)); // the array of tuples is the arguments list
 }
 /****************************************************************************************
- * Changes the value of the specified field for tuple that matched the specified 'key'.
- * The tuple will be searched in the specified index 'indexName' (any unique index).
+ * Set tuples written by MsgPack::TupleBatch. The array of tuples becomes the arguments
+ * of the script as is: no QVariant, no re-encoding.
 ****************************************************************************************/
 bool
-QTarantool::changeData(const QString &spaceName, const IndexKey &key, const int field, const QVariant &value, const QString &indexName)
+QTarantool::setBuilt(const QString &spaceName, MsgPack::TupleBatch &&tuples)
 {
-	if(!key.size())
+const MsgPack::Packed packed =tuples.build();
+
+	if(packed.Data.size() <= 1) // empty array
 		return(false);
 
-	if(indexName.isEmpty())
-		return(exec(tr("box.space['%1']:update(...)").arg(spaceName), {key, List { List {"=", field, value}}}).IsValid);
-	else
-		return(exec(tr("box.space['%1'].index['%2']:update(...)").arg(spaceName).arg(indexName), {key, List { List {"=", field, value}}}).IsValid);
+return(execPacked(batchScript(spaceName), packed.Data));
+}
+/****************************************************************************************
+ * Batches are cut by encoded size instead of a tuple count. The byte budget is tuned
+ * AIMD-style by the ack latency of every batch: grows by a fixed step while the latency
+ * is within the target, halved when it is over. The budget is kept for the next calls.
+ * The batch is one array argument: a big budget of small tuples would exceed
+ * the limit of the Lua arguments count.
+****************************************************************************************/
+bool
+QTarantool::setDataAdaptive(const QString &spaceName, const QList<QVariantList> &tuples)
+{
+const QString lua =batchScript(spaceName, true);
+const int step =qMax(BatchMaxBytes / 256, BATCH_MIN_BYTES);
+QElapsedTimer total, stage;
+qint64 encodeNs =0, ackNs =0;
+bool result =true;
+
+	pipelinestats =PIPELINE_STATS();
+	total.start();
+
+	for(auto it =tuples.begin(); it != tuples.end() && result;)
+	{
+	MsgPack::Builder batch(BatchBytes + BatchBytes / 8);
+
+		stage.start();
+		batch.beginArray(); // the arguments
+		batch.beginArray(); // the tuples
+
+		do // at least one tuple, the last one may cross the budget
+		{
+			batch.beginArray();
+
+			for(const auto &field : *it++)
+				batch << field;
+
+			batch.end();
+			pipelinestats.Tuples++;
+		}
+		while(it != tuples.end() && batch.data().size() < BatchBytes);
+
+		encodeNs +=stage.nsecsElapsed();
+		stage.start();
+		result =execPacked(lua, batch.build().Data);
+
+	const qint64 ns =stage.nsecsElapsed();
+
+		ackNs +=ns;
+		pipelinestats.Batches++;
+
+		if(ns > BatchTarget * qint64(1000000))
+			BatchBytes =qMax(BatchBytes / 2, BATCH_MIN_BYTES);
+		else
+			BatchBytes =qMin(BatchBytes + step, BatchMaxBytes);
+	}
+
+const double elapsedNs =qMax(total.nsecsElapsed(), qint64(1));
+
+	pipelinestats.Elapsed =total.elapsed();
+	pipelinestats.TuplesPerSec =pipelinestats.Tuples * 1e9 / elapsedNs;
+	pipelinestats.EncodeBusy =encodeNs / elapsedNs;
+	pipelinestats.AckWait =ackNs / elapsedNs; // send + server + ack
+	pipelinestats.BatchBytes =BatchBytes;
+
+return(result);
+}
+/****************************************************************************************
+ * 'maxBatchBytes' is bounded by int, so it is below IPROTO_BODY_LEN_MAX.
+ * The budget starts again from 64 KB.
+****************************************************************************************/
+void
+QTarantool::setBatchTuning(const int targetLatency, const int maxBatchBytes)
+{
+	BatchTarget =qMax(targetLatency, 1);
+	BatchMaxBytes =qMax(maxBatchBytes, BATCH_MIN_BYTES);
+	BatchBytes =qMin(64 * 1024, BatchMaxBytes);
+}
+/****************************************************************************************
+ * Same as setData(tuples, batchSize), but stages are overlapped:
+ * batch N+1 is encoded on QThreadPool while batch N is on the wire and batch N-1 waits for ack.
+ * Up to 2 batches are in flight, acks are matched by IPROTO_SYNC.
+ * Throughput and stages load of the last call: getPipelineStats().
+****************************************************************************************/
+bool
+QTarantool::setDataPipelined(const QString &spaceName, const QList<QVariantList> &tuples, const int batchSize)
+{
+const int size =qMax(batchSize, 1);
+const int batches =(tuples.size() + size - 1) / size;
+const QString lua =batchScript(spaceName);
+QVector<QByteArray> bodies(batches);
+QVector<qint64> encodeNs(batches);
+QScopedArrayPointer<QSemaphore> ready(new QSemaphore[batches]);
+QThreadPool *pool =QThreadPool::globalInstance();
+QList<quint64> inflight; // sync of sent batches waiting for ack
+QElapsedTimer total, stage;
+qint64 sendNs =0, ackNs =0;
+int started =0, acquired =0;
+bool result =true;
+
+	pipelinestats =PIPELINE_STATS();
+	total.start();
+
+auto encode =[&](const int n) {
+
+	auto it =tuples.begin() + n * size;
+	EncodeTask *task =new EncodeTask(lua, QVariantList(it, (n + 1) * size < tuples.size() ? it + size : tuples.end()), bodies[n], encodeNs[n], ready[n]);
+
+		if(!pool->tryStart(task)) // no free thread - encode here
+		{
+			task->run();
+			delete task;
+		}
+	};
+
+	while(started < batches && started < 2)
+		encode(started++);
+
+	for(int b =0; b < batches && result; b++)
+	{
+		ready[b].acquire();
+		acquired++;
+
+		if(started < batches)
+			encode(started++);
+
+	QUIntMap hdr;
+
+		hdr[IPROTO_REQUEST_TYPE] =IPROTO_EVAL;
+
+	QByteArray request =packet(hdr, bodies[b]);
+
+		MsgPack::BufferPool::release(std::move(bodies[b]));
+		stage.start();
+		result =post(request);
+		sendNs +=stage.nsecsElapsed();
+		MsgPack::BufferPool::release(std::move(request));
+
+		if(!result)
+			break;
+
+		inflight.append(hdr[IPROTO_SYNC].toULongLong());
+
+		stage.start();
+
+		while(result && inflight.size() >= 2)
+			result =receiveAck(inflight);
+
+		ackNs +=stage.nsecsElapsed();
+	}
+
+	stage.start();
+
+	while(inflight.size()) // keep the stream in sync even after error
+		result &=receiveAck(inflight);
+
+	ackNs +=stage.nsecsElapsed();
+
+	for(; acquired < started; acquired++) // encoders still referencing local buffers
+		ready[acquired].acquire();
+
+qint64 encodeTotal =0;
+
+	for(const auto ns : encodeNs)
+		encodeTotal +=ns;
+
+const double elapsedNs =qMax(total.nsecsElapsed(), qint64(1));
+
+	pipelinestats.Tuples =tuples.size();
+	pipelinestats.Batches =batches;
+	pipelinestats.Elapsed =total.elapsed();
+	pipelinestats.TuplesPerSec =tuples.size() * 1e9 / elapsedNs;
+	pipelinestats.EncodeBusy =encodeTotal / elapsedNs;
+	pipelinestats.SendBusy =sendNs / elapsedNs;
+	pipelinestats.AckWait =ackNs / elapsedNs;
+
+return(result);
+}
+/****************************************************************************************
+ * Insert new 1(one) tuple by primary index
+ * If the tuple exists, method will return an error.
+****************************************************************************************/
+bool
+QTarantool::insertData(const QString &spaceName, const QVariantList &tuple) // [FIXME] double values
+{
+	if(tuple.size())
+		return(exec(tr("box.space['%1']:insert{...}").arg(spaceName), tuple).IsValid);
+
+return(false);
+}
+/****************************************************************************************
+ * Same as insertData(tuple), the fields are written by MsgPack::TupleBuilder.
+****************************************************************************************/
+bool
+QTarantool::insertBuilt(const QString &spaceName, MsgPack::TupleBuilder &&tuple)
+{
+const MsgPack::Packed packed =tuple.build();
+
+	if(packed.Data.size() <= 1) // empty array
+		return(false);
+
+return(execPacked(tr("box.space['%1']:insert{...}").arg(spaceName), packed.Data));
+}
+/****************************************************************************************
+ * Changes the value of the specified field for tuple that matched the specified 'key'.
+ * The tuple will be searched in the specified index 'indexName' (any unique index).
+****************************************************************************************/
+bool
+QTarantool::changeData(const QString &spaceName, const IndexKey &key, const int field, const QVariant &value, const QString &indexName)
+{
+	if(key.isNull())
+		return(false);
+
+	if(indexName.isEmpty())
+		return(exec(tr("box.space['%1']:update(...)").arg(spaceName), {key.values(), List { List {"=", field, value}}}).IsValid);
+	else
+		return(exec(tr("box.space['%1'].index['%2']:update(...)").arg(spaceName).arg(indexName), {key.values(), List { List {"=", field, value}}}).IsValid);
+}
+/****************************************************************************************
+ * Applies the chosen 'actions' to the fields of the selected tuple by 'key' in any unique index 'indexName'.
+****************************************************************************************/
+bool
+QTarantool::changeData(const QString &spaceName, const IndexKey &key, const Actions &actions, const QString &indexName)
+{
+	if(key.isNull())
+		return(false);
+
+	if(indexName.isEmpty())
+		return(exec(tr("box.space['%1']:update(...)").arg(spaceName), {key.values(), {actions}}).IsValid);
+	else
+		return(exec(tr("box.space['%1'].index['%2']:update(...)").arg(spaceName).arg(indexName), {key.values(), {actions}}).IsValid);
+}
+/****************************************************************************************
+ * Inserts 'tuple' if the tuple with its primary key does not exist,
+ * otherwise applies 'actions' to the existing one (fields from 1). Primary index only.
+****************************************************************************************/
+bool
+QTarantool::upsertData(const QString &spaceName, const QVariantList &tuple, const Actions &actions)
+{
+	return(upsertData(spaceName, QList<QVariantList> {tuple}, QList<QVariantList> {actions}));
+}
+/****************************************************************************************
+ * Same as upsertData(tuple, actions) for every pair of 'tuples' and 'actions'.
+ * The requests are pipelined (up to 64 in flight), the server does not return the tuples.
+ * 'failed' - indexes of the upserts failed or not acknowledged (lost connection).
+ * Returns: 'false' if any of the upserts failed (the last error is kept).
+****************************************************************************************/
+bool
+QTarantool::upsertData(const QString &spaceName, const QList<QVariantList> &tuples, const QList<QVariantList> &actions, QList<int> *failed)
+{
+QList<quint64> inflight; // sync of sent upserts waiting for ack
+QHash<quint64, int> requests; // sync : index of the upsert
+int sent =0;
+
+	if(failed)
+		failed->clear();
+
+auto fail =[&](const int from) { // the upserts not sent
+
+		if(failed)
+			for(int c =from; c < tuples.size(); c++)
+				failed->append(c);
+
+	return(false);
+	};
+
+	if(tuples.isEmpty() || tuples.size() != actions.size())
+		return(fail(0));
+
+const uint spaceId =getSpaceId(spaceName);
+
+	if(!spaceId)
+		return(fail(0));
+
+bool result =true;
+ERROR failure ={0, ""};
+auto ack =[&] {
+
+	quint64 sync =0;
+
+		if(receiveAck(inflight, &sync))
+		{
+			requests.remove(sync);
+
+		return;
+		}
+
+		if(!failure.code)
+			failure =lasterror;
+
+		if(failed && sync)
+			failed->append(requests.value(sync));
+		else
+		if(failed) // lost stream: no acks of the others
+			failed->append(requests.values());
+
+		if(sync)
+			requests.remove(sync);
+		else
+			requests.clear();
+	};
+
+	for(int c =0; c < tuples.size() && result; c++)
+	{
+	QUIntMap hdr, body;
+
+		hdr[IPROTO_REQUEST_TYPE] =IPROTO_UPSERT;
+		body[IPROTO_SPACE_ID] =spaceId;
+		body[IPROTO_INDEX_BASE] =1;
+		body[IPROTO_TUPLE] =tuples[c];
+		body[IPROTO_OPS] =actions[c];
+
+	QByteArray request =packet(hdr, MsgPack::pack(body));
+
+		result =post(request);
+		MsgPack::BufferPool::release(std::move(request));
+
+		if(!result)
+			break;
+
+		sent++;
+		inflight.append(hdr[IPROTO_SYNC].toULongLong());
+		requests.insert(inflight.last(), c);
+
+		while(inflight.size() >= 64)
+			ack();
+	}
+
+	while(inflight.size()) // keep the stream in sync even after error
+		ack();
+
+	if(!result)
+		fail(sent);
+
+	if(failed)
+		std::sort(failed->begin(), failed->end());
+
+	if(failure.code)
+	{
+		lasterror =failure;
+
+	return(false);
+	}
+
+return(result);
+}
+/****************************************************************************************
+ * Delete tuple by 'key'
+****************************************************************************************/
+bool
+QTarantool::deleteData(const QString &spaceName, const IndexKey &key, const QString &indexName)
+{
+	if(key.isNull())
+		return(false);
+
+MsgPack::Builder args(64);
+
+	args.beginArray() << spaceName;
+
+	if(indexName.isEmpty())
+		args.addNull();
+	else
+		args << indexName;
+
+	args << MsgPack::Packed::fromData(key.encoding());
+
+return(execEncoded(QByteArrayLiteral("local sp, ix, k =...;"
+									 "local s =box.space[sp];"
+									 "(ix and s.index[ix] or s):delete(k)"), args.build().Data).IsValid);
+}
+/****************************************************************************************
+ * Returns the quantity of tuples in the Space.
+ *    0: space is empty
+ * (-1): on error
+****************************************************************************************/
+qlonglong
+QTarantool::getSpaceLength(const QString &spaceName)
+{
+	exec("return box.space[...]:len()", {spaceName});
+
+	if(Reply.IsValid)
+		return(Reply.Data[IPROTO_DATA].toList()[0].value<qlonglong>());
+
+return(-1);
+}
+/****************************************************************************************
+ * Returns the size taken by data (tuples) of Space in bytes.
+****************************************************************************************/
+qlonglong
+QTarantool::getSpaceSize(const QString &spaceName)
+{
+	exec("return box.space[...]:bsize()", {spaceName});
+
+	if(Reply.IsValid)
+		return(Reply.Data[IPROTO_DATA].toList()[0].value<qlonglong>());
+
+return(-1);
+}
+/****************************************************************************************
+ * Returns empty columns set by the format of the Space (cached).
+ * The cache is cleared on reconnect and when the Space is changed by this object.
+****************************************************************************************/
+const MsgPack::Columns &
+QTarantool::spaceFormat(const QString &spaceName)
+{
+auto it =SpaceFormats.constFind(spaceName);
+
+	if(it != SpaceFormats.constEnd())
+		return(it.value());
+
+	exec("return box.space[...]:format()", {spaceName});
+
+	if(!Reply.IsValid)
+		return(COLUMNSNULL);
+
+const QVariantList format =Reply.Data[IPROTO_DATA].toList()[0].toList();
+
+	if(format.isEmpty())
+	{
+		setLastError({-1, tr("Space '%1' has no format.").arg(spaceName)});
+
+	return(COLUMNSNULL);
+	}
+
+QVector<MsgPack::Columns::Type> types;
+QStringList names;
+
+	for(const auto &field : format)
+	{
+	const QVariantMap attr =field.toMap();
+
+		names.append(attr["name"].toString());
+		types.append(MsgPack::Columns::fieldType(attr["type"].toString()));
+	}
+
+return(*SpaceFormats.insert(spaceName, MsgPack::Columns(types, names)));
+}
+/****************************************************************************************
+ * Return: List all spaces with attributes
+****************************************************************************************/
+const QVariantList &
+QTarantool::spaces()
+{
+	exec("return box.space._space:select{}");
+
+const auto &DataList =reinterpret_cast<const QVariantList &>(Reply.Data[IPROTO_DATA]);
+
+	if(Reply.IsValid)
+		return(reinterpret_cast<const QVariantList &>(DataList[0]));
+
+return(LISTNULL);
+}
+/****************************************************************************************
+ *
+****************************************************************************************/
+bool
+QTarantool::createIndex(const QString &spaceName, const QString &indexName, const Parts &parts, const QStringList &options)
+{
+QStringList tmp(options);
+// [FIXME] format string is temp solution
+	tmp +=("parts =" + parts.text());
+
+return(exec(tr("box.space['%1']:create_index('%2', {%3})").arg(spaceName).arg(indexName).arg(tmp.join(','))).IsValid);
+}
+/****************************************************************************************
+ *
+****************************************************************************************/
+bool
+QTarantool::isIndexExist(const QString &spaceName, const QString &indexName)
+{
+	exec(tr("return box.space['%1'].index['%2'] ~= null").arg(spaceName).arg(indexName));
+
+	if(Reply.IsValid)
+		return(Reply.Data[IPROTO_DATA].toList()[0].toBool());
+
+return(false);
+}
+/****************************************************************************************
+ *
+****************************************************************************************/
+bool
+QTarantool::deleteIndex(const QString &spaceName, const QString &indexName)
+{
+	return(exec(tr("box.space['%1'].index['%2']:drop()").arg(spaceName).arg(indexName)).IsValid);
+}
+/****************************************************************************************
+ * Returns all indexes of all Spaces as a map (UIntMap),
+ * where the map key is the Id of the associated Space.
+****************************************************************************************/
+const QUIntMap
+QTarantool::indexes()
+{
+	exec("return box.space._index:select{}");
+
+	if(Reply.IsValid)
+	{
+	QUIntMap indexes;
+
+		for(const auto& varAttr : Reply.Data[IPROTO_DATA].toList()[0].toList())
+		{
+		const QVariantList &attr =varAttr.toList();
+		uint spaceId =attr[0].toUInt();
+		QVariantList &indexes_ref =reinterpret_cast<QVariantList &>(indexes[spaceId].isValid() ? indexes[spaceId] : (indexes[spaceId] =QVariantList {}));
+
+			indexes_ref.append(QVariantMap { // indexes[spaceId] = <index attributes>
+
+				{"iid", attr[1]},
+				{"name", attr[2]},
+				{"type", attr[3]},
+				{"opts", attr[4]},
+				{"parts", attr[5]}
+			});
+		}
+
+	return(indexes);
+	}
+
+return(QUIntMap {});
+}
+/****************************************************************************************
+ * Calls an arbitrary Lua-function on the server.
+****************************************************************************************/
+const REPLY &
+QTarantool::call(const QString &function, const QVariantList &args)
+{
+QUIntMap hdr, body;
+
+	hdr[IPROTO_REQUEST_TYPE] =IPROTO_CALL;
+	body[IPROTO_FUNCTION_NAME] =function;
+	body[IPROTO_TUPLE] =args;
+
+return(sendRequest(hdr, body));
+}
+/****************************************************************************************
+ * Executes an arbitrary Lua-expression on the server.
+****************************************************************************************/
+const REPLY &
+QTarantool::exec(const QString &script, const QVariantList &args)
+{
+QUIntMap hdr, body;
+
+	hdr[IPROTO_REQUEST_TYPE] =IPROTO_EVAL;
+	body[IPROTO_EXPR] =script;
+	body[IPROTO_TUPLE] =args;
+
+return(sendRequest(hdr, body));
+}
+/****************************************************************************************
+ * Executes an arbitrary Lua-expression on the server.
+ * The reply is decoded into the arena-backed document (no QVariant tree).
+ * Return: document of 3 values - <size>, <header>, <body>, or empty document on error.
+****************************************************************************************/
+const MsgPack::Document &
+QTarantool::execDocument(const QString &script, const QVariantList &args)
+{
+QUIntMap hdr, body;
+
+	hdr[IPROTO_REQUEST_TYPE] =IPROTO_EVAL;
+	body[IPROTO_EXPR] =script;
+	body[IPROTO_TUPLE] =args;
+
+return(sendRequestDocument(hdr, MsgPack::pack(body)));
+}
+/****************************************************************************************
+ * Executes an arbitrary SQL-request to the server.
+ * Returns:
+****************************************************************************************/
+const REPLY &
+QTarantool::execSQL(const QString &query, const QVariantList &args, const QVariantList &options)
+{
+QUIntMap hdr, body;
+
+	hdr[IPROTO_REQUEST_TYPE] =IPROTO_EXECUTE;
+	body[IPROTO_SQL_TEXT] =query;
+	body[IPROTO_SQL_BIND] =args;
+	body[IPROTO_OPTIONS] =options;
+
+return(sendRequest(hdr, body));
+}
+/****************************************************************************************
+ * Subscribes to the key of box.broadcast() (Tarantool 2.10+). The server sends the current
+ * value at once and then every change as IPROTO_EVENT, each one is acknowledged by the next
+ * IPROTO_WATCH. The events are taken while waiting for replies or from the event loop
+ * and emitted by signalEvent(). The keys are watched again after reconnect.
+ * The key shared with the cache or the change feed is counted: it is unwatched on the server
+ * by the last unwatch().
+****************************************************************************************/
+bool
+QTarantool::watch(const QString &key)
+{
+	if(bInit && !hasFeature(FEATURE_WATCHERS))
+	{
+		setLastError({-1, "The server does not support watchers."});
+
+	return(false);
+	}
+
+	if(Watches[key]++) // already watched on the server
+		return(true);
+
+return(postWatch(IPROTO_WATCH, key));
+}
+
+bool
+QTarantool::unwatch(const QString &key)
+{
+auto it =Watches.find(key);
+
+	if(it == Watches.end())
+		return(false);
+
+	if(--it.value())
+		return(true);
+
+	Watches.erase(it);
+
+return(postWatch(IPROTO_UNWATCH, key));
+}
+/****************************************************************************************
+ * IPROTO_WATCH / IPROTO_UNWATCH have no reply. They are not sent to the server
+ * without watchers: its error reply would be taken for the reply of the next request.
+ * Not sent while replicate(): the master takes the connection for the relay.
+****************************************************************************************/
+bool
+QTarantool::postWatch(const int requestType, const QString &key)
+{
+	if((bInit && !hasFeature(FEATURE_WATCHERS)) || bReplicating)
+		return(false);
+
+QUIntMap hdr, body;
+
+	hdr[IPROTO_REQUEST_TYPE] =requestType;
+	body[IPROTO_EVENT_KEY] =key;
+
+QByteArray request =packet(hdr, MsgPack::pack(body));
+const bool result =post(request);
+
+	MsgPack::BufferPool::release(std::move(request));
+
+return(result);
+}
+/****************************************************************************************
+ * The cache of the watched key is cleared at once, the signal and the poll of the change feed
+ * are queued: the event can come in the middle of other request.
+****************************************************************************************/
+void
+QTarantool::dispatchEvent(const QByteArray &packet)
+{
+REPLY event;
+
+	event =MsgPack::unpack(packet);
+
+const QString key =event.Data[IPROTO_EVENT_KEY].toString();
+const QVariant data =event.Data.value(IPROTO_EVENT_DATA);
+
+	if(Watches.contains(key))
+		postWatch(IPROTO_WATCH, key); // ack: the next change will be sent
+
+	if(CacheWatches.contains(key))
+	{
+	const auto cache =Caches.value(CacheWatches[key]);
+
+		if(cache)
+			cache->clear();
+	}
+
+	QMetaObject::invokeMethod(this, [this, key, data] {
+
+		emit signalEvent(key, data);
+
+		if(key.startsWith("qtnt.feed."))
+		{
+		const QString spaceName =key.mid(10);
+
+			for(const auto &s : Subscriptions.value(spaceName))
+				if(data.toLongLong() > s.Seq)
+					pollFeed(spaceName, s.Consumer);
+		}
+	}, Qt::QueuedConnection);
+}
+/****************************************************************************************
+ * Primary key lookups of getData() (selectorFrom EQ in "primary", no selectorTo, no fields)
+ * of the space are served from the client cache within 'bytes'.
+ * The cache is cleared by the change of 'watchKey' (default "qtnt.cache.<spaceName>"),
+ * see installCacheTrigger(), and on reconnect.
+ * Returns: false if the watch request is not sent (the key is watched after connect).
+ * The server without watchers has no cache: it would not be invalidated.
+****************************************************************************************/
+bool
+QTarantool::enableCache(const QString &spaceName, const qint64 bytes, const QString &watchKey)
+{
+	if(bytes <= 0)
+		return(false);
+
+	if(bInit && !hasFeature(FEATURE_WATCHERS))
+	{
+		setLastError({-1, "The server does not support watchers."});
+
+	return(false);
+	}
+
+const QString key =(watchKey.isEmpty() ? "qtnt.cache." + spaceName : watchKey);
+
+	disableCache(spaceName);
+	Caches.insert(spaceName, QSharedPointer<TupleCache>::create(bytes));
+	CacheWatches.insert(key, spaceName);
+
+return(watch(key));
+}
+
+void
+QTarantool::disableCache(const QString &spaceName)
+{
+	Caches.remove(spaceName);
+
+	for(auto it =CacheWatches.begin(); it != CacheWatches.end();)
+		if(it.value() == spaceName)
+		{
+			unwatch(it.key());
+			it =CacheWatches.erase(it);
+		}
+		else
+			++it;
+}
+/****************************************************************************************
+ * Sets on_replace trigger of the space broadcasting 'watchKey' after every commit.
+ * The trigger is not persistent: it should be installed again after the server restart
+ * (or put into the server init script).
+****************************************************************************************/
+bool
+QTarantool::installCacheTrigger(const QString &spaceName, const QString &watchKey)
+{
+	return(exec("local sp, key = ...;"
+				"qtnt_cache_triggers = qtnt_cache_triggers or {};"
+				"local n = 0;"
+				"local f = function() box.on_commit(function() n = n + 1; box.broadcast(key, n) end) end;"
+				"box.space[sp]:on_replace(f, qtnt_cache_triggers[sp]);"
+				"qtnt_cache_triggers[sp] = f", {spaceName, watchKey.isEmpty() ? "qtnt.cache." + spaceName : watchKey}).IsValid);
+}
+
+TupleCache::Stats
+QTarantool::cacheStats(const QString &spaceName)
+{
+const auto cache =Caches.value(spaceName);
+
+return(cache ? cache->stats() : TupleCache::Stats());
+}
+/****************************************************************************************
+ * Installs the change feed of the space on the server (not persistent, see installCacheTrigger())
+ * and watches its key "qtnt.feed.<spaceName>". The changes after the cursor of 'consumer'
+ * are fetched by batches of 'batchSize' from the event loop and passed to 'handler',
+ * each fetch acknowledges the previous batch. The log keeps the changes not acknowledged
+ * by some consumer, but not more than the last 'feedLimit'.
+ * A named 'consumer' continues from its acknowledged change after reconnect
+ * (while the log reaches back), the default one is unique for the call.
+ * All feeds are polled once after reconnect (a lost feed is reported by signalFeedLost()).
+ * The server without watchers is polled by the timer. A space can have many consumers,
+ * subscribe() of the same consumer replaces its handler.
+ * Return: the consumer (the handle of the subscription), empty - error.
+****************************************************************************************/
+QString
+QTarantool::subscribe(const QString &spaceName, const ChangeHandler &handler, const QString &consumer, const int batchSize, const int feedLimit)
+{
+Subscription s;
+
+	s.Handler =handler;
+	s.Consumer =(consumer.isEmpty() ? QUuid::createUuid().toString() : consumer);
+	s.BatchSize =qMax(batchSize, 1);
+	s.FeedLimit =qMax(feedLimit, 1);
+
+	unsubscribe(spaceName, s.Consumer);
+
+const REPLY &installed =exec(FEED_INSTALL, {spaceName, s.FeedLimit, s.Consumer});
+
+	if(!installed.IsValid)
+		return("");
+
+	s.Seq =installed.Data[IPROTO_DATA].toList().value(0).toLongLong();
+
+const bool bFirst =!Subscriptions.contains(spaceName); // the feed key is watched once per space
+
+	Subscriptions[spaceName].insert(s.Consumer, s);
+
+	if(!hasFeature(FEATURE_WATCHERS))
+	{
+		if(!FeedTimer.isActive())
+			FeedTimer.start(FEED_POLL_INTERVAL);
+
+	return(s.Consumer);
+	}
+
+	if(!bFirst) // the changes after the cursor are polled now, the events are shared
+	{
+		QMetaObject::invokeMethod(this, [this, spaceName, name =s.Consumer] { pollFeed(spaceName, name); }, Qt::QueuedConnection);
+
+	return(s.Consumer);
+	}
+
+	if(!watch("qtnt.feed." + spaceName)) // the first event polls the changes after the cursor
+	{
+		unsubscribe(spaceName, s.Consumer);
+
+	return("");
+	}
+
+return(s.Consumer);
+}
+/****************************************************************************************
+ * The cursor of the consumer is removed from the server feed.
+ * 'consumer' empty - all subscriptions of the space.
+****************************************************************************************/
+bool
+QTarantool::unsubscribe(const QString &spaceName, const QString &consumer)
+{
+auto space =Subscriptions.find(spaceName);
+
+	if(space == Subscriptions.end())
+		return(false);
+
+const QStringList consumers =(consumer.isEmpty() ? space->keys() : QStringList {consumer});
+
+	if(!consumer.isEmpty() && !space->remove(consumer))
+		return(false);
+
+	if(consumer.isEmpty() || space->isEmpty())
+	{
+		Subscriptions.erase(space);
+		unwatch("qtnt.feed." + spaceName);
+	}
+
+	if(Subscriptions.isEmpty())
+		FeedTimer.stop();
+
+bool result =true;
+
+	for(const auto &c : consumers)
+		result &=exec(FEED_LEAVE, {spaceName, c}).IsValid;
+
+return(result);
+}
+/****************************************************************************************
+ * Subscription of the consumer to the space, nullptr - none.
+ * The pointer is valid until the subscriptions are changed.
+****************************************************************************************/
+QTarantool::Subscription *
+QTarantool::subscription(const QString &spaceName, const QString &consumer)
+{
+auto space =Subscriptions.find(spaceName);
+
+	if(space == Subscriptions.end())
+		return(nullptr);
+
+auto it =space->find(consumer);
+
+return(it != space->end() ? &it.value() : nullptr);
+}
+/****************************************************************************************
+ * Passes the changes after the acknowledged one to the handler until the feed is empty
+ * or the handler does not acknowledge a batch. The handler may call any method.
+ * If the log does not reach back the feed is installed again, the consumer starts
+ * from the current change and signalFeedLost() is emitted.
+ * 'consumer' empty - all subscriptions of the space.
+****************************************************************************************/
+bool
+QTarantool::pollFeed(const QString &spaceName, const QString &consumer)
+{
+	if(consumer.isEmpty())
+	{
+	bool result =true;
+
+		for(const auto &c : Subscriptions.value(spaceName).keys()) // the handlers can (un)subscribe
+			if(subscription(spaceName, c))
+				result &=pollFeed(spaceName, c);
+
+	return(result);
+	}
+
+Subscription *it =subscription(spaceName, consumer);
+
+	if(!it || it->bPolling)
+		return(false);
+
+	it->bPolling =true;
+
+bool result =true;
+bool bLost =false;
+
+	forever
+	{
+	const REPLY &reply =exec(FEED_FETCH, {spaceName, consumer, it->Seq, it->BatchSize});
+
+		if(!reply.IsValid)
+		{
+			result =false;
+			break;
+		}
+
+	const QVariantList data =reply.Data[IPROTO_DATA].toList();
+
+		if(data.size() < 2) // gap
+		{
+		const REPLY &installed =exec(FEED_INSTALL, {spaceName, it->FeedLimit, consumer});
+
+			if(!installed.IsValid)
+				result =false;
+			else
+			{
+				it->Seq =installed.Data[IPROTO_DATA].toList().value(0).toLongLong();
+				bLost =true;
+			}
+
+			break;
+		}
+
+	QList<CHANGE> changes;
+	qint64 seq =it->Seq;
+
+		for(const auto &change : data[1].toList())
+		{
+		const QVariantList c =change.toList();
+
+			changes.append({++seq, c.value(0).toList(), c.value(1).toList()});
+		}
+
+		if(changes.isEmpty())
+			break;
+
+	const ChangeHandler handler =it->Handler; // the handler can (un)subscribe
+	const bool bAck =handler(changes);
+
+		it =subscription(spaceName, consumer);
+
+		if(!it)
+			return(result);
+
+		if(!bAck)
+			break;
+
+		it->Seq =seq;
+	}
+
+	it->bPolling =false;
+
+	if(bLost)
+		emit signalFeedLost(spaceName, consumer);
+
+return(result);
+}
+
+qint64
+QTarantool::feedSequence(const QString &spaceName, const QString &consumer)
+{
+const Subscription *it =subscription(spaceName, consumer);
+
+return(it ? it->Seq : -1);
+}
+/****************************************************************************************
+ * Joins the master as an anonymous replica (IPROTO_SUBSCRIBE, Tarantool 2.5+): the master
+ * streams the rows of its write ahead log after 'vclock' ({} - after the current vclock
+ * of the master, read with the replicaset UUID) without Lua. The DML rows are emitted
+ * by signalRow() from the event loop, the other rows (IPROTO_NOP, raft, synchro) only
+ * move the vclock. The received vclock is sent back on the master heartbeats
+ * and once a second while rows come. The user requires 'replication' role.
+ * The connection carries the rows only until disconnectServer().
+****************************************************************************************/
+bool
+QTarantool::replicate(const QUIntMap &vclock, const QString &instanceUuid)
+{
+const REPLY &info =exec("local i = box.info; local c = {};"
+						"for id, lsn in pairs(i.vclock) do if id ~= 0 then c[#c + 1] = {id, lsn} end end;" // [[id, lsn], ...]: no array/map guess, 0 - local
+						"return i.replicaset and i.replicaset.uuid or i.cluster.uuid, c");
+
+	if(!info.IsValid)
+		return(false);
+
+const QVariantList data =info.Data[IPROTO_DATA].toList();
+const QString clusterUuid =data.value(0).toString();
+QUIntMap from =vclock;
+QUIntMap hdr, body, clock;
+
+	if(from.isEmpty()) // the rows after the current state, not the whole WAL
+		for(const auto &component : data.value(1).toList())
+			from[component.toList().value(0).toUInt()] =component.toList().value(1);
+
+	for(auto it =from.cbegin(); it != from.cend(); ++it) // LSN is unsigned
+		clock[it.key()] =it.value().toULongLong();
+
+	hdr[IPROTO_REQUEST_TYPE] =IPROTO_SUBSCRIBE;
+	body[IPROTO_CLUSTER_UUID] =clusterUuid;
+	body[IPROTO_INSTANCE_UUID] =(instanceUuid.isEmpty() ? QUuid::createUuid().toString().mid(1, 36) : instanceUuid);
+	body[IPROTO_VCLOCK] =QVariant::fromValue(clock);
+	body[IPROTO_REPLICA_ANON] =true;
+	body[IPROTO_SERVER_VERSION] =versionId(); // as the master
+
+	if(!sendRequest(hdr, body).IsValid)
+		return(false);
+
+	ReplicaVclock =from;
+	bReplicating =true;
+	ReplicaAck.start();
+	QMetaObject::invokeMethod(this, [this] { on_SocketReadyRead(); }, Qt::QueuedConnection); // rows received with the reply
+
+return(true);
+}
+/****************************************************************************************
+ * Row of the replication stream: <size> <header> [<body>].
+ * An error ends the stream and closes the connection.
+****************************************************************************************/
+void
+QTarantool::dispatchRow(const QByteArray &packet)
+{
+const QVariantList parts =MsgPack::unpack(packet).toList();
+const QUIntMap header =qvariant_cast<QUIntMap>(parts.value(1));
+const QUIntMap body =qvariant_cast<QUIntMap>(parts.value(2));
+const int type =header.value(IPROTO_REQUEST_TYPE).toInt();
+
+	if(type & IPROTO_TYPE_ERROR)
+	{
+		setLastError({type & 0x7FFF, body.value(ERROR_STRING).toString()});
+		disconnectServer();
+
+	return;
+	}
+
+	if(type == IPROTO_OK) // heartbeat
+	{
+		sendVclock();
+
+	return;
+	}
+
+ROW row;
+
+	row.Type =type;
+	row.ReplicaId =header.value(IPROTO_REPLICA_ID).toUInt();
+	row.Lsn =header.value(IPROTO_LSN).toLongLong();
+	row.Timestamp =header.value(IPROTO_TIMESTAMP).toDouble();
+	row.SpaceId =body.value(IPROTO_SPACE_ID).toUInt();
+	row.IndexId =body.value(IPROTO_INDEX_ID).toUInt();
+	row.Key =body.value(IPROTO_KEY).toList();
+
+	if(type == IPROTO_UPDATE) // the operations are in IPROTO_TUPLE
+		row.Ops =body.value(IPROTO_TUPLE).toList();
+	else
+	{
+		row.Tuple =body.value(IPROTO_TUPLE).toList();
+		row.Ops =body.value(IPROTO_OPS).toList();
+	}
+
+	if(row.ReplicaId) // 0 - local space
+		ReplicaVclock[row.ReplicaId] =row.Lsn;
+
+	switch(type) // raft, synchro, nop - only the vclock
+	{
+	case IPROTO_INSERT:
+	case IPROTO_REPLACE:
+	case IPROTO_UPDATE:
+	case IPROTO_DELETE:
+	case IPROTO_UPSERT:
+		emit signalRow(row);
+	}
+}
+/****************************************************************************************
+ * The master drops a replica silent longer than replication_timeout * 4.
+****************************************************************************************/
+bool
+QTarantool::sendVclock()
+{
+QUIntMap hdr, body, clock;
+
+	for(auto it =ReplicaVclock.cbegin(); it != ReplicaVclock.cend(); ++it)
+		clock[it.key()] =it.value().toULongLong();
+
+	hdr[IPROTO_REQUEST_TYPE] =IPROTO_OK;
+	body[IPROTO_VCLOCK] =QVariant::fromValue(clock);
+	ReplicaAck.restart();
+
+QByteArray request =packet(hdr, MsgPack::pack(body));
+const bool result =write(request);
+
+	MsgPack::BufferPool::release(std::move(request));
+
+return(result);
+}
+/****************************************************************************************
+ * IPROTO_ID (Tarantool 2.10+): protocol version and features of the server.
+ * The error reply of an older server is not reported: it has no features.
+****************************************************************************************/
+void
+QTarantool::identify()
+{
+QUIntMap hdr, body;
+REPLY id;
+
+	ProtocolVersion =0;
+	Features.clear();
+	hdr[IPROTO_REQUEST_TYPE] =IPROTO_ID;
+	body[IPROTO_VERSION] =PROTOCOL_VERSION;
+	body[IPROTO_FEATURES] =QVariantList {FEATURE_WATCHERS}; // used by the client
+
+QByteArray data =MsgPack::packPooled(body);
+QByteArray packet =transmit(hdr, data);
+
+	id =MsgPack::unpack(packet);
+	MsgPack::BufferPool::release(std::move(data));
+	MsgPack::BufferPool::release(std::move(packet));
+
+	if(id.IsValid && id.Header[IPROTO_STATUS] == IPROTO_OK)
+	{
+		ProtocolVersion =id.Data[IPROTO_VERSION].toInt();
+
+		for(const auto &feature : id.Data[IPROTO_FEATURES].toList())
+			Features.insert(feature.toInt());
+	}
+}
+
+uint
+QTarantool::versionId()
+{
+const QRegularExpressionMatch v =QRegularExpression("(\\d+)\\.(\\d+)\\.(\\d+)").match(version);
+
+return((v.captured(1).toUInt() << 16) | (v.captured(2).toUInt() << 8) | v.captured(3).toUInt());
+}
+/****************************************************************************************
+ * Streams the read view of the master the way an anonymous replica joins (Tarantool 2.5+):
+ * the rows are read from the socket as they come, without Lua and select requests.
+ * The server sends all spaces, the tuples of other spaces are skipped.
+ * snapshotVclock() is the vclock after the last row, replicate(snapshotVclock())
+ * continues with the changes. The user requires 'replication' role.
+****************************************************************************************/
+bool
+QTarantool::fetchSnapshot(const QStringList &spaceNames, const SnapshotHandler &handler)
+{
+	return(fetchSnapshotRows(spaceNames, [&handler](const QString &spaceName, const QByteArray &tuple) {
+
+		return(handler(spaceName, MsgPack::unpack(tuple).toList()));
+	}));
+}
+/****************************************************************************************
+ * The tuples are copied into the file as received: [<space name>, <tuple>] per tuple
+ * after the array32 header, its count is written when the fetch is done.
+ * MsgPack::unpack() of the file gives the list of the pairs. The file of a failed fetch is removed.
+****************************************************************************************/
+bool
+QTarantool::fetchSnapshot(const QStringList &spaceNames, const QString &fileName)
+{
+QFile file(fileName);
+
+	if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		setLastError({-1, tr("Cannot open file '%1': %2").arg(fileName, file.errorString())});
+
+	return(false);
+	}
+
+QHash<QString, QByteArray> names; // space name : packed head of the pair "[<space name>,"
+
+	for(const auto &name : spaceNames)
+		names.insert(name, char(0x92) + MsgPack::pack(name));
+
+QByteArray head(5, '\0'); // array32 of the pairs, the count is set after the fetch
+quint32 count =0;
+
+	head[0] =char(0xDD);
+	file.write(head);
+
+const bool result =fetchSnapshotRows(spaceNames, [&file, &names, &count](const QString &spaceName, const QByteArray &tuple) {
+
+		if(file.write(names[spaceName]) <= 0 || file.write(tuple) != tuple.size())
+			return(false);
+
+		count++;
+
+	return(true);
+	});
+
+	qToBigEndian(count, head.data() + 1);
+
+	if(result && !(file.seek(0) && file.write(head) == head.size() && file.flush()))
+	{
+		setLastError({-1, tr("Cannot write file '%1': %2").arg(fileName, file.errorString())});
+		file.remove();
+
+	return(false);
+	}
+
+	if(!result)
+		file.remove(); // the pairs after the header of 0 would be read as garbage
+
+return(result);
+}
+/****************************************************************************************
+ * IPROTO_FETCH_SNAPSHOT: the reply (vclock of the read view), the rows, the end marker
+ * IPROTO_OK with the vclock. The rows are not decoded into QVariant, only the tuples
+ * of the requested spaces are passed to 'sink'. A stopped fetch closes the connection:
+ * the rest of the stream can not be skipped.
+****************************************************************************************/
+bool
+QTarantool::fetchSnapshotRows(const QStringList &spaceNames, const std::function<bool(const QString &spaceName, const QByteArray &tuple)> &sink)
+{
+QHash<uint, QString> spaces; // id : name
+
+	for(const auto &name : spaceNames)
+	{
+	const uint id =getSpaceId(name);
+
+		if(!id)
+		{
+			setLastError({-1, tr("Space '%1' not found.").arg(name)});
+
+		return(false);
+		}
+
+		spaces.insert(id, name);
+	}
+
+QUIntMap hdr, body;
+
+	hdr[IPROTO_REQUEST_TYPE] =IPROTO_FETCH_SNAPSHOT;
+	body[IPROTO_SERVER_VERSION] =versionId();
+
+	if(!sendRequest(hdr, body).IsValid)
+		return(false);
+
+BusyGuard busy(bBusy);
+QElapsedTimer tmr; // since the last packet
+bool bLost =false;
+bool bMalformed =false;
+
+	tmr.start();
+
+	do
+	{
+		RxBuffer +=socket->readAll();
+
+	QByteArray packet;
+
+		while((packet =takePacket(bLost)).size())
+		{
+		int type;
+		uint spaceId;
+		QByteArray tuple;
+
+			tmr.restart();
+
+			if(is_event(packet))
+			{
+				dispatchEvent(packet);
+				continue;
+			}
+
+			if(!snapshot_row(packet, type, spaceId, tuple))
+			{
+				bMalformed =true;
+				break;
+			}
+
+			if(type & IPROTO_TYPE_ERROR)
+			{
+				setReply(packet);
+
+			return(false);
+			}
+
+			if(type == IPROTO_OK) // the end
+			{
+			REPLY end;
+
+				end =MsgPack::unpack(packet);
+				SnapshotVclock =qvariant_cast<QUIntMap>(end.Data.value(IPROTO_VCLOCK));
+
+			return(true);
+			}
+
+			if(type == IPROTO_INSERT && tuple.size() && spaces.contains(spaceId) && !sink(spaces[spaceId], tuple))
+			{
+				disconnectServer();
+				setLastError({-1, "Snapshot fetch is stopped."});
+
+			return(false);
+			}
+		}
+
+		if(bLost || bMalformed)
+			break;
+	}
+	while(isConnected() && !tmr.hasExpired(TIMEOUT) && socket->waitForReadyRead(TIMEOUT - tmr.elapsed()));
+
+	disconnectServer(); // the rest of the stream would be taken for replies
+	setLastError({-1, (bLost || bMalformed) ? "Malformed server response." : "Snapshot fetch is interrupted."});
+
+return(false);
 }
 /****************************************************************************************
- * Applies the chosen 'actions' to the fields of the selected tuple by 'key' in any unique index 'indexName'.
+ * Prepares and sends a request msgpack-packet to the server.
+ * If it receives an error status from the server it will return an empty REPLY structure,
+ * - see REPLY structure assignment operator overloading.
 ****************************************************************************************/
-bool
-QTarantool::changeData(const QString &spaceName, const IndexKey &key, const Actions &actions, const QString &indexName)
+const REPLY &
+QTarantool::sendRequest(QUIntMap &header, const QUIntMap &body)
 {
-	if(!key.size())
-		return(false);
+QByteArray data =MsgPack::packPooled(body);
+QByteArray packet =transmit(header, data);
 
-	if(indexName.isEmpty())
-		return(exec(tr("box.space['%1']:update(...)").arg(spaceName), {key, {actions}}).IsValid);
-	else
-		return(exec(tr("box.space['%1'].index['%2']:update(...)").arg(spaceName).arg(indexName), {key, {actions}}).IsValid);
+	MsgPack::BufferPool::release(std::move(data));
+	setReply(packet); // decoded into QVariant, the packet is not referenced
+	MsgPack::BufferPool::release(std::move(packet));
+
+return(Reply);
 }
 /****************************************************************************************
- * Delete tuple by 'key'
+ * Decodes the raw reply packet into Reply and checks the reply status.
 ****************************************************************************************/
-bool
-QTarantool::deleteData(const QString &spaceName, const IndexKey &key, const QString &indexName)
+const REPLY &
+QTarantool::setReply(const QByteArray &packet)
 {
-	if(!key.size())
-		return(false);
+	Reply =MsgPack::unpack(packet);
 
-	if(indexName.isEmpty())
-		return(exec(tr("box.space['%1']:delete{...}").arg(spaceName), key).IsValid);
+	if(!Reply.IsValid)
+		setLastError({-1, "Malformed server response."});
 	else
-		return(exec(tr("box.space['%1'].index['%2']:delete{...}").arg(spaceName).arg(indexName), key).IsValid);
+	if(Reply.Header[IPROTO_STATUS] != IPROTO_OK) // if ERROR return
+	{
+		Reply.IsValid =false;
+		setLastError({Reply.Header[IPROTO_STATUS].toInt() & 0x7FFF, Reply.Data[ERROR_STRING].toString()});
+	}
+
+return(Reply);
 }
 /****************************************************************************************
- * Returns the quantity of tuples in the Space.
- *    0: space is empty
- * (-1): on error
+ * Same as sendRequest(), but the server reply is decoded into the arena-backed document.
+ * If it receives an error status from the server it will return an empty document.
 ****************************************************************************************/
-qlonglong
-QTarantool::getSpaceLength(const QString &spaceName)
+const MsgPack::Document &
+QTarantool::sendRequestDocument(QUIntMap &header, const QByteArray &body)
 {
-	exec("return box.space[...]:len()", {spaceName});
-
-	if(Reply.IsValid)
-		return(Reply.Data[IPROTO_DATA].toList()[0].value<qlonglong>());
+	if(!ReplyDocument.parse(transmit(header, body)) || ReplyDocument.count() != 3) // <size> + <header> + <body>
+	{
+		ReplyDocument.clear();
+		setLastError({-1, "Malformed server response."});
+	}
+	else
+	if(ReplyDocument[1][IPROTO_STATUS].toUInt() != IPROTO_OK) // if ERROR return
+	{
+		setLastError({ReplyDocument[1][IPROTO_STATUS].toInt() & 0x7FFF, ReplyDocument[2][ERROR_STRING].toString()});
+		ReplyDocument.clear();
+	}
 
-return(-1);
+return(ReplyDocument);
 }
 /****************************************************************************************
- * Returns the size taken by data (tuples) of Space in bytes.
+ * Executes Lua-expression on the server and keeps the reply packet raw (not decoded).
+ * Return: offset of the first returned value in 'packet', or -1 on error.
 ****************************************************************************************/
-qlonglong
-QTarantool::getSpaceSize(const QString &spaceName)
+int
+QTarantool::execRaw(const QString &script, QByteArray &packet, const QVariantList &args)
 {
-	exec("return box.space[...]:bsize()", {spaceName});
+QUIntMap hdr, body;
 
-	if(Reply.IsValid)
-		return(Reply.Data[IPROTO_DATA].toList()[0].value<qlonglong>());
+	hdr[IPROTO_REQUEST_TYPE] =IPROTO_EVAL;
+	body[IPROTO_EXPR] =script;
+	body[IPROTO_TUPLE] =args;
 
-return(-1);
-}
-/****************************************************************************************
- * Return: List all spaces with attributes
-****************************************************************************************/
-const QVariantList &
-QTarantool::spaces()
-{
-	exec("return box.space._space:select{}");
+QByteArray data =MsgPack::packPooled(body);
 
-const auto &DataList =reinterpret_cast<const QVariantList &>(Reply.Data[IPROTO_DATA]);
+	packet =transmit(hdr, data);
+	MsgPack::BufferPool::release(std::move(data));
 
-	if(Reply.IsValid)
-		return(reinterpret_cast<const QVariantList &>(DataList[0]));
+const int offset =replyDataOffset(packet); // IPROTO_DATA: [<value>, ...]
 
-return(LISTNULL);
+	if(offset < 0)
+	{
+		setReply(packet); // error status or malformed reply
+
+	return(-1);
+	}
+
+quint8 *begin =reinterpret_cast<quint8 *>(packet.data());
+quint32 len =0;
+bool isMap =false;
+quint8 *p =MsgPackPrivate::unpack_container_len(begin + offset, begin + packet.size(), len, isMap);
+
+	if(!p || isMap || !len)
+	{
+		setLastError({-1, "Malformed server response."});
+
+	return(-1);
+	}
+
+return(static_cast<int>(p - begin));
 }
 /****************************************************************************************
- *
+ * Executes Lua-expression with the arguments already encoded as msgpack array.
+ * The body is written directly, the reply is only checked for the error status (not decoded).
 ****************************************************************************************/
 bool
-QTarantool::createIndex(const QString &spaceName, const QString &indexName, const Parts &parts, const QStringList &options)
+QTarantool::execPacked(const QString &script, const QByteArray &args)
 {
-QStringList tmp(options);
-// [FIXME] format string is temp solution
-	tmp +=("parts =" + parts.text());
+QUIntMap hdr;
+QByteArray body =evalBody(script.toUtf8(), args);
 
-return(exec(tr("box.space['%1']:create_index('%2', {%3})").arg(spaceName).arg(indexName).arg(tmp.join(','))).IsValid);
+	hdr[IPROTO_REQUEST_TYPE] =IPROTO_EVAL;
+
+QByteArray packet =transmit(hdr, body);
+const bool result =(replyDataOffset(packet) >= 0);
+
+	if(!result)
+		setReply(packet); // error status or malformed reply
+
+	MsgPack::BufferPool::release(std::move(body));
+	MsgPack::BufferPool::release(std::move(packet));
+
+return(result);
 }
 /****************************************************************************************
- *
+ * Same as execPacked(), the reply is decoded into Reply.
+ * The script is UTF-8 (constant scripts are not converted on every call).
+ * 'requestType' IPROTO_CALL : 'script' is the name of the function.
 ****************************************************************************************/
-bool
-QTarantool::isIndexExist(const QString &spaceName, const QString &indexName)
+const REPLY &
+QTarantool::execEncoded(const QByteArray &script, const QByteArray &args, const int requestType)
 {
-	exec(tr("return box.space['%1'].index['%2'] ~= null").arg(spaceName).arg(indexName));
+QUIntMap hdr;
+QByteArray body =evalBody(script, args, requestType == IPROTO_CALL ? IPROTO_FUNCTION_NAME : IPROTO_EXPR);
 
-	if(Reply.IsValid)
-		return(Reply.Data[IPROTO_DATA].toList()[0].toBool());
+	hdr[IPROTO_REQUEST_TYPE] =requestType;
 
-return(false);
+QByteArray packet =transmit(hdr, body);
+
+	setReply(packet);
+	MsgPack::BufferPool::release(std::move(body));
+	MsgPack::BufferPool::release(std::move(packet));
+
+return(Reply);
 }
 /****************************************************************************************
- *
+ * EVAL body {IPROTO_EXPR: script, IPROTO_TUPLE: args} written around the encoded arguments.
+ * 'textKey' IPROTO_FUNCTION_NAME : CALL body.
 ****************************************************************************************/
-bool
-QTarantool::deleteIndex(const QString &spaceName, const QString &indexName)
+QByteArray
+QTarantool::evalBody(const QByteArray &script, const QByteArray &args, const int textKey)
 {
-	return(exec(tr("box.space['%1'].index['%2']:drop()").arg(spaceName).arg(indexName)).IsValid);
+QByteArray body =MsgPack::BufferPool::acquire(script.size() + args.size() + 8);
+
+	body +=static_cast<char>(MsgPack::FirstByte::FIXMAP | 2);
+	body +=static_cast<char>(textKey);
+	body.resize(body.size() + script.size() + 5);
+
+quint8 *p =reinterpret_cast<quint8 *>(body.data()) + 2;
+
+	body.resize(static_cast<int>(MsgPackPrivate::pack_string_raw(script.constData(), script.size(), p, true) - p) + 2);
+	body +=static_cast<char>(IPROTO_TUPLE);
+	body +=args;
+
+return(body);
 }
 /****************************************************************************************
- * Returns all indexes of all Spaces as a map (UIntMap),
- * where the map key is the Id of the associated Space.
+ * Locates the IPROTO_DATA value in the raw reply packet <size><header><body> without decoding.
+ * Return: offset of the value, or -1 on error status / malformed packet.
 ****************************************************************************************/
-const QUIntMap
-QTarantool::indexes()
+int
+QTarantool::replyDataOffset(const QByteArray &packet)
 {
-	exec("return box.space._index:select{}");
+quint8 *begin =reinterpret_cast<quint8 *>(const_cast<char *>(packet.constData()));
+const quint8 *end =begin + packet.size();
+quint8 *p =MsgPackPrivate::skip(begin, end); // <size>
+quint32 len =0;
+bool isMap =false;
 
-	if(Reply.IsValid)
+	if(p)
+		p =MsgPackPrivate::unpack_container_len(p, end, len, isMap); // <header>
+
+	for(quint32 c =0; c < len && p && isMap; c++)
 	{
-	QUIntMap indexes;
+		if(*p == IPROTO_STATUS && (p + 1 >= end || p[1] != IPROTO_OK))
+			return(-1);
 
-		for(const auto& varAttr : Reply.Data[IPROTO_DATA].toList()[0].toList())
-		{
-		const QVariantList &attr =varAttr.toList();
-		uint spaceId =attr[0].toUInt();
-		QVariantList &indexes_ref =reinterpret_cast<QVariantList &>(indexes[spaceId].isValid() ? indexes[spaceId] : (indexes[spaceId] =QVariantList {}));
+		p =MsgPackPrivate::skip(p, end); // key
 
-			indexes_ref.append(QVariantMap { // indexes[spaceId] = <index attributes>
+		if(p)
+			p =MsgPackPrivate::skip(p, end); // value
+	}
 
-				{"iid", attr[1]},
-				{"name", attr[2]},
-				{"type", attr[3]},
-				{"opts", attr[4]},
-				{"parts", attr[5]}
-			});
-		}
+	if(p && isMap)
+		p =MsgPackPrivate::unpack_container_len(p, end, len, isMap); // <body>
 
-	return(indexes);
+	for(quint32 c =0; c < len && p && isMap; c++)
+	{
+		if(*p == IPROTO_DATA)
+			return(static_cast<int>(p + 1 - begin));
+
+		p =MsgPackPrivate::skip(p, end);
+
+		if(p)
+			p =MsgPackPrivate::skip(p, end);
 	}
 
-return(QUIntMap {});
+return(-1);
 }
 /****************************************************************************************
- * Calls an arbitrary Lua-function on the server.
+ * Sends the request packet (header + msgpack-encoded body) to the server.
+ * Returns: raw reply packet <size><header><body>, or empty array on error/timeout.
 ****************************************************************************************/
-const REPLY &
-QTarantool::call(const QString &function, const QVariantList &args)
+QByteArray
+QTarantool::transmit(QUIntMap &header, const QByteArray &body)
 {
-QUIntMap hdr, body;
+	if(bReplicating) // the replies would be mixed with the rows
+		return(QByteArray());
 
-	hdr[IPROTO_REQUEST_TYPE] =IPROTO_CALL;
-	body[IPROTO_FUNCTION_NAME] =function;
-	body[IPROTO_TUPLE] =args;
+QByteArray request =packet(header, body);
+const bool sent =send(request);
 
-return(sendRequest(hdr, body));
+	MsgPack::BufferPool::release(std::move(request));
+
+	if(!sent)
+		return(QByteArray());
+
+return(receive(header[IPROTO_SYNC].toULongLong()));
 }
 /****************************************************************************************
- * Executes an arbitrary Lua-expression on the server.
+ * Builds the request packet <size><header><body>, assigns the next sync to the header.
 ****************************************************************************************/
-const REPLY &
-QTarantool::exec(const QString &script, const QVariantList &args)
+QByteArray
+QTarantool::packet(QUIntMap &header, const QByteArray &body)
 {
-QUIntMap hdr, body;
+	lasterror ={0, ""};
+	header[IPROTO_SYNC] =(++syncId);
 
-	hdr[IPROTO_REQUEST_TYPE] =IPROTO_EVAL;
-	body[IPROTO_EXPR] =script;
-	body[IPROTO_TUPLE] =args;
+QByteArray hdr =MsgPack::packPooled(header);
+QByteArray request =MsgPack::BufferPool::acquire(sizeof(HDR_DATA_SIZE) + hdr.size() + body.size());
 
-return(sendRequest(hdr, body));
+	request.resize(sizeof(HDR_DATA_SIZE));
+	request +=hdr;
+	request +=body;
+	MsgPack::BufferPool::release(std::move(hdr));
+
+	((HDR_DATA_SIZE *)request.data())->mp_hdr =0xCE; // CONST MP_UINT
+	((HDR_DATA_SIZE *)request.data())->data_size =(request.size() - sizeof(HDR_DATA_SIZE));
+
+return(request);
 }
 /****************************************************************************************
- * Executes an arbitrary SQL-request to the server.
- * Returns:
+ * Reads exactly one packet <size><header><body> from the socket.
+ * A large reply can come in several parts, the bytes of the next packet remain in RxBuffer.
+ * 'sync' - the reply to this request only: late replies of timed out requests are dropped.
+ * Returns: raw packet, or empty array on timeout.
 ****************************************************************************************/
-const REPLY &
-QTarantool::execSQL(const QString &query, const QVariantList &args, const QVariantList &options)
+QByteArray
+QTarantool::receive(const quint64 sync)
 {
-QUIntMap hdr, body;
+BusyGuard busy(bBusy);
+QElapsedTimer tmr;
+bool bLost =false;
 
-	hdr[IPROTO_REQUEST_TYPE] =IPROTO_EXECUTE;
-	body[IPROTO_SQL_TEXT] =query;
-	body[IPROTO_SQL_BIND] =args;
-	body[IPROTO_OPTIONS] =options;
+	tmr.start();
 
-return(sendRequest(hdr, body));
+	do
+	{
+		RxBuffer +=socket->readAll();
+
+	QByteArray packet;
+
+		while((packet =takePacket(bLost)).size())
+			if(is_event(packet)) // not a reply - wait on
+				dispatchEvent(packet);
+			else
+			if(!sync || packet_sync(packet) == sync)
+				return(packet);
+			// else: late reply of a timed out request - dropped
+
+		if(bLost)
+			return(QByteArray());
+	}
+	while(isConnected() && !tmr.hasExpired(TIMEOUT) && socket->waitForReadyRead(TIMEOUT - tmr.elapsed()));
+
+return(QByteArray());
 }
 /****************************************************************************************
- * Prepares and sends a request msgpack-packet to the server.
- * If it receives an error status from the server it will return an empty REPLY structure,
- * - see REPLY structure assignment operator overloading.
+ * Takes one whole packet from RxBuffer.
+ * Returns: the packet, or empty array if it is not received yet
+ * ('bLost' - lost packet boundary, RxBuffer is cleared).
 ****************************************************************************************/
-const REPLY &
-QTarantool::sendRequest(QUIntMap &header, const QUIntMap &body)
+QByteArray
+QTarantool::takePacket(bool &bLost)
 {
-	lasterror ={0, ""};
-	header[IPROTO_SYNC] =(++syncId);
+	if(RxBuffer.size() < (int)sizeof(HDR_DATA_SIZE))
+		return(QByteArray());
 
-QByteArray request(sizeof(HDR_DATA_SIZE), Qt::Uninitialized);
+const HDR_DATA_SIZE *hdr =reinterpret_cast<const HDR_DATA_SIZE *>(RxBuffer.constData());
+const qint64 packetSize =sizeof(HDR_DATA_SIZE) + hdr->data_size;
 
-	request +=MsgPack::pack(header);
-	request +=MsgPack::pack(body);
-
-	((HDR_DATA_SIZE *)request.data())->mp_hdr =0xCE; // CONST MP_UINT
-	((HDR_DATA_SIZE *)request.data())->data_size =(request.size() - sizeof(HDR_DATA_SIZE));
+	if(hdr->mp_hdr != 0xCE) // lost packet boundary
+	{
+		RxBuffer.clear();
+		bLost =true;
 
-	send(request);
+	return(QByteArray());
+	}
 
-	Reply =MsgPack::unpack(socket->readAll());
+	if(RxBuffer.size() == packetSize) // usual case - one whole packet, no copy
+		return(std::move(RxBuffer));
 
-	if(!Reply.IsValid)
-		setLastError({-1, "Malformed server response."});
-	else
-	if(Reply.Header[IPROTO_STATUS] != IPROTO_OK) // if ERROR return
+	if(RxBuffer.size() > packetSize)
 	{
-		Reply.IsValid =false;
-		setLastError({Reply.Header[IPROTO_STATUS].toInt() & 0x7FFF, Reply.Data[ERROR_STRING].toString()});
+	QByteArray packet =RxBuffer.left(packetSize);
+
+		RxBuffer.remove(0, packetSize);
+
+	return(packet);
 	}
 
-return(Reply);
+return(QByteArray());
 }
 /****************************************************************************************
  * Send raw data to server
@@ -749,6 +3182,7 @@ return(Reply);
 qint64
 QTarantool::send(const QByteArray &data)
 {
+BusyGuard busy(bBusy);
 qint64 qwSended =0;
 
     if(isConnected() && (qwSended =socket->write(data)) && socket->waitForBytesWritten(TIMEOUT))
@@ -756,6 +3190,70 @@ qint64 qwSended =0;
 
 return(qwSended);
 }
+/****************************************************************************************
+ * Writes the request without waiting for the reply (pipelining).
+ * Not while replicate(): its reply would be mixed with the rows.
+****************************************************************************************/
+bool
+QTarantool::post(const QByteArray &data)
+{
+	if(bReplicating)
+	{
+		setLastError({-1, "Request is not sent: the connection carries the replication rows."});
+
+	return(false);
+	}
+
+return(write(data));
+}
+
+bool
+QTarantool::write(const QByteArray &data)
+{
+BusyGuard busy(bBusy);
+
+	if(!isConnected() || socket->write(data) != data.size() || !socket->waitForBytesWritten(TIMEOUT))
+	{
+		setLastError({-1, "Request is not sent."});
+
+	return(false);
+	}
+
+return(true);
+}
+/****************************************************************************************
+ * Receives the reply to one of pipelined requests, the request is removed from 'inflight' by sync.
+ * 'sync' - sync of the reply, 0 - lost stream.
+ * Returns: false on error status of the reply, or on lost stream (all 'inflight' are dropped).
+****************************************************************************************/
+bool
+QTarantool::receiveAck(QList<quint64> &inflight, quint64 *sync)
+{
+MsgPack::Document ack(receive());
+
+	if(sync)
+		*sync =0;
+
+	if(ack.count() != 3 || !inflight.removeOne(ack[1][IPROTO_SYNC].toULongLong())) // <size> + <header> + <body>
+	{
+		inflight.clear();
+		setLastError({-1, "Malformed server response."});
+
+	return(false);
+	}
+
+	if(sync)
+		*sync =ack[1][IPROTO_SYNC].toULongLong();
+
+	if(ack[1][IPROTO_STATUS].toUInt() != IPROTO_OK)
+	{
+		setLastError({ack[1][IPROTO_STATUS].toInt() & 0x7FFF, ack[2][ERROR_STRING].toString()});
+
+	return(false);
+	}
+
+return(true);
+}
 /****************************************************************************************
  * Socket events handlers
 ****************************************************************************************/
@@ -764,6 +3262,36 @@ QTarantool::on_SocketConnected() // ignore
 {
 	qDebug("Connected to server. [%d]", isConnected());
 	syncId =0;
+	RxBuffer.clear();
+	SpaceFormats.clear();
+	Predicates.clear();
+	bReplicating =false;
+
+	for(auto &cache : Caches) // changes are not watched without the connection
+		cache->clear();
+}
+//----------------------------------------------------------------------------------------
+void
+QTarantool::on_SocketReadyRead()
+{
+	if(bBusy || (Watches.isEmpty() && !bReplicating)) // the reply is read by receive()
+		return;
+
+	RxBuffer +=socket->readAll();
+
+QByteArray packet;
+bool bLost =false;
+
+	while((packet =takePacket(bLost)).size())
+		if(is_event(packet))
+			dispatchEvent(packet);
+		else
+		if(bReplicating)
+			dispatchRow(packet);
+		// else: late reply of a timed out request - dropped
+
+	if(bReplicating && ReplicaAck.hasExpired(1000))
+		sendVclock();
 }
 //----------------------------------------------------------------------------------------
 void
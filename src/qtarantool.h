@@ -17,11 +17,20 @@
 #include <QJsonObject>
 #include <QJsonDocument>
 #include <QJsonArray>
+#include <QSet>
+#include <QSharedPointer>
 #include <QCryptographicHash>
+#include <functional>
 #include <QDebug>
 //#include "msgpuck/msgpuck.h"
 #include "lib/qmsgpack/msgpack.h"
+#include "lib/qmsgpack/msgpackdocument.h"
+#include "lib/qmsgpack/msgpackcolumns.h"
+#include "lib/qmsgpack/msgpackjson.h"
+#include "lib/qmsgpack/msgpackbuilder.h"
+#include "lib/qmsgpack/msgpackbufferpool.h"
 #include "lib/QUnSocket/qunsocket.h"
+#include "tuplecache.h"
 
 namespace QTNT
 {
@@ -98,6 +107,44 @@ struct ERROR
 	int code;
 	QString text;
 };
+// committed change of a tuple delivered by QTarantool::subscribe()
+struct CHANGE
+{
+	qint64 Seq;			// number of the change in the feed of the space
+	QVariantList Old;	// empty - insert
+	QVariantList New;	// empty - delete
+};
+// row of the master write ahead log streamed by QTarantool::replicate()
+struct ROW
+{
+	int Type;			// IPROTO_INSERT, IPROTO_REPLACE, IPROTO_UPDATE, IPROTO_DELETE, IPROTO_UPSERT
+	uint ReplicaId;		// instance of the change in the replicaset
+	qint64 Lsn;
+	double Timestamp;	// seconds since epoch
+	uint SpaceId;
+	uint IndexId;
+	QVariantList Tuple;	// insert, replace, upsert
+	QVariantList Key;	// update, delete
+	QVariantList Ops;	// update, upsert
+};
+// 'false' - stop the snapshot fetch
+typedef std::function<bool(const QString &spaceName, const QVariantList &tuple)> SnapshotHandler;
+// 'true' - the changes are processed and acknowledged, 'false' - they are delivered again by the next poll
+typedef std::function<bool(const QList<CHANGE> &changes)> ChangeHandler;
+// batchSize of setData(tuples): batches are sized by encoded bytes and ack latency (see setBatchTuning())
+const int BATCH_ADAPTIVE =0;
+// statistics of the last setDataPipelined() or adaptive setData()
+struct PIPELINE_STATS
+{
+	qint64 Tuples =0;
+	qint64 Batches =0;
+	qint64 Elapsed =0;		// ms
+	double TuplesPerSec =0;
+	double EncodeBusy =0;	// fraction of elapsed time the stage was busy (encode: sum of all workers)
+	double SendBusy =0;
+	double AckWait =0;		// fraction of elapsed time spent waiting for acks
+	int BatchBytes =0;		// adaptive setData(): byte budget of a batch at the end
+};
 
 enum SLAB { // [INFO] https://www.tarantool.io/en/doc/latest/reference/reference_lua/box_slab/slab_info/
 
@@ -113,6 +160,20 @@ enum STAT {	// [INFO] https://www.tarantool.io/en/doc/latest/reference/reference
 	VINYL		// Shows vinyl-storage-engine activity
 };
 
+enum FEATURE { // [INFO] https://www.tarantool.io/en/doc/latest/reference/internals/iproto/requests/#iproto-id
+
+	FEATURE_STREAMS =0,					// IPROTO_STREAM_ID
+	FEATURE_TRANSACTIONS,				// IPROTO_BEGIN, IPROTO_COMMIT, IPROTO_ROLLBACK
+	FEATURE_ERROR_EXTENSION,			// MP_ERROR
+	FEATURE_WATCHERS,					// IPROTO_WATCH, IPROTO_UNWATCH, IPROTO_EVENT
+	FEATURE_PAGINATION,					// IPROTO_AFTER_POSITION, IPROTO_FETCH_POSITION
+	FEATURE_SPACE_AND_INDEX_NAMES,		// IPROTO_SPACE_NAME, IPROTO_INDEX_NAME
+	FEATURE_WATCH_ONCE,					// IPROTO_WATCH_ONCE
+	FEATURE_DML_TUPLE_EXTENSION,
+	FEATURE_CALL_RET_TUPLE_EXTENSION,
+	FEATURE_CALL_ARG_TUPLE_EXTENSION
+};
+
 enum OPERATOR {
 
 	ALL =0, // Synonym for 'GE'
@@ -194,6 +255,28 @@ public:
 			qDebug("Construct error: %d", nestingLevel);
 		}
 	}
+	// Single-pass parser of the key text (same syntax and result as IndexKey(const QString &), but much faster).
+	// On error the key is invalid and 'errorPos' is the position of the error in the text, else -1.
+	static IndexKey
+	parse(const QString &text, int *errorPos =nullptr);
+	inline bool
+	isValid() const { return(IsValid); }
+	// Keys with msgpack encoding computed once. The encoding is sent as is by getData(key)/deleteData(key).
+	// The encoding is a cache of the list: it is not used after any non-const access to the list.
+	static IndexKey
+	fromInt(const qint64 id); // encoding is stored inline
+	static IndexKey
+	fromStr(const QString &id);
+	static IndexKey
+	encoded(const IndexKey &key);
+	inline bool
+	isEncoded() const { return((InlineSize || !Encoded.isEmpty()) && isSharedWith(EncodedList)); }
+	inline bool
+	isNull() const { return(isEmpty()); }
+	QByteArray
+	encoding() const; // msgpack array of the key parts (the cached one if encoded)
+	inline QVariantList
+	values() const { return(*this); } // key parts
 	 // index to string
 	inline const QString
 	text() const
@@ -211,6 +294,10 @@ public:
 private:
 
 	bool IsValid =true;
+	quint8 InlineSize =0;
+	quint8 Inline[10];	// fixarray(1) + int64
+	QByteArray Encoded;
+	QVariantList EncodedList; // shares the data of the encoded list: any change of the key detaches it
 
 	IndexKey(QStringList::Iterator &beginKey, QStringList::Iterator &endKey, int nestingLevel =0, int *pEndIndexKeyCount =nullptr)
 	{
@@ -283,6 +370,72 @@ private:
 	}
 
 } Key;
+/************************************************************************************************
+ * Filter of tuples checked on the server (see QTarantool::filter()).
+ * Fields - number (from 1) or name of the space format. The structure of the predicate (shape)
+ * is compiled to a server function once, values are passed as parameters of the call:
+ *
+ *	Predicate::gt(3, 100) && (Predicate::in("city", {"Paris", "Rome"}) || !Predicate::prefix(2, "tmp"))
+************************************************************************************************/
+class Predicate
+{
+public:
+	Predicate() { } // any tuple
+
+	static inline Predicate
+	eq(const QVariant &field, const QVariant &value) { return(compare(field, "==", value)); }
+	static inline Predicate
+	ne(const QVariant &field, const QVariant &value) { return(compare(field, "~=", value)); }
+	static inline Predicate
+	lt(const QVariant &field, const QVariant &value) { return(compare(field, "<", value)); }
+	static inline Predicate
+	le(const QVariant &field, const QVariant &value) { return(compare(field, "<=", value)); }
+	static inline Predicate
+	gt(const QVariant &field, const QVariant &value) { return(compare(field, ">", value)); }
+	static inline Predicate
+	ge(const QVariant &field, const QVariant &value) { return(compare(field, ">=", value)); }
+	static Predicate
+	in(const QVariant &field, const QVariantList &values);
+	static Predicate
+	prefix(const QVariant &field, const QString &prefix); // string field starts with 'prefix'
+	static Predicate
+	isNull(const QVariant &field);
+
+	Predicate
+	operator&&(const Predicate &p) const { return(join(And, p)); }
+	Predicate
+	operator||(const Predicate &p) const { return(join(Or, p)); }
+	Predicate
+	operator!() const;
+	// Lua-expression over tuple 't' and parameters 'p[n]', the values are appended to 'params'.
+	// 'prologue' - code executed once per call (e.g. sets of IN-lists).
+	QString
+	compile(QVariantList &params, QString &prologue) const;
+
+private:
+	enum Kind : quint8 {
+
+		Always =0,
+		Compare,
+		InList,
+		Prefix,
+		IsNull,
+		And,
+		Or,
+		Not
+	};
+
+	Kind Type =Always;
+	QVariant Field;
+	QString Op;
+	QVariant Value;
+	QList<Predicate> Operands;
+
+	static Predicate
+	compare(const QVariant &field, const char *op, const QVariant &value);
+	Predicate
+	join(const Kind type, const Predicate &p) const;
+};
 /************************************************************************************************
  *									Tarantool class
 ************************************************************************************************/
@@ -304,6 +457,25 @@ public:
 		IndexKey Key;
 		QString  IndexName;
 	};
+	// for aggregate() method
+	struct Aggregate
+	{
+		Aggregate(const QString &function, const QVariant &field =0) : Function(function), Field(field) { }
+
+		QString  Function; // 'count', 'sum', 'min', 'max', 'avg'
+		QVariant Field;    // field number (from 1) or name, not used by 'count'
+
+		static inline Aggregate
+		Count() { return(Aggregate("count")); }
+		static inline Aggregate
+		Sum(const QVariant &field) { return(Aggregate("sum", field)); }
+		static inline Aggregate
+		Min(const QVariant &field) { return(Aggregate("min", field)); }
+		static inline Aggregate
+		Max(const QVariant &field) { return(Aggregate("max", field)); }
+		static inline Aggregate
+		Avg(const QVariant &field) { return(Aggregate("avg", field)); }
+	};
 	// for 'Set' tuple methods
 	typedef struct FieldAction
 	{
@@ -400,6 +572,10 @@ public:
 	disconnectServer();
 	inline bool
 	isConnected() { return(socket->isConnected()); }
+	inline bool
+	hasFeature(const FEATURE feature) { return(Features.contains(feature)); } // negotiated by IPROTO_ID at connect
+	inline int
+	protocolVersion() { return(ProtocolVersion); } // 0 - the server has no IPROTO_ID (before 2.10)
 	qint64
 	ping();
 	const QVariantMap &
@@ -453,20 +629,50 @@ public:
 	bool
 	isSpaceExist(const QString &spaceName);
 	const QVariantList &
-	getData(const QString &spaceName, const Selector &selectorFrom, const Selector &selectorTo ={}, const uint limit =1000);
+	getData(const QString &spaceName, const Selector &selectorFrom, const Selector &selectorTo ={}, const uint limit =1000, const QVariantList &fields ={});
 	const QVariant &
 	getData(const QString &spaceName, const IndexKey &key, const uint field, const QString &indexName ="");
+	const QVariantList &
+	aggregate(const QString &spaceName, const Selector &selectorFrom, const Selector &selectorTo, const QList<Aggregate> &aggregates); // results in the order of 'aggregates', computed on the server over the selection
+	const QVariantList &
+	filter(const QString &spaceName, const Selector &selectorFrom, const Predicate &predicate, const uint limit =1000); // tuples of the selection matching 'predicate', checked on the server
+	inline void
+	resetPredicates() { Predicates.clear(); } // compile predicates again (e.g. after server restart)
+	const QVariantList &
+	getMany(const QString &spaceName, const QList<IndexKey> &keys, const QList<uint> &fields ={}, const QString &indexName =""); // tuples (or 'fields' of tuples) in the order of keys in one request, miss - null QVariant
+	MsgPack::Document::Value
+	getDocument(const QString &spaceName, const Selector &selectorFrom, const Selector &selectorTo ={}, const uint limit =1000, const QVariantList &fields ={}); // same as getData() but without QVariant tree
+	MsgPack::Columns
+	getColumns(const QString &spaceName, const Selector &selectorFrom, const Selector &selectorTo ={}, const uint limit =1000, const QVariantList &fields ={}); // same as getData() but decoded into typed columns by the space format
+	QByteArray
+	getJson(const QString &spaceName, const Selector &selectorFrom, const Selector &selectorTo ={}, const uint limit =1000, const QVariantList &fields ={}); // same as getData() but as JSON text
 	bool
 	setData(const QString &spaceName, const QVariantList &tuple, const bool bIfExist =true); // Set existing tuple (by primary index of tuple) Or Insert as new if not exist.
 	bool
-	setData(const QString &spaceName, const QList<QVariantList> &tuples, const int batchSize =1000);
+	setData(const QString &spaceName, const QList<QVariantList> &tuples, const int batchSize =1000); // batchSize BATCH_ADAPTIVE - sized by bytes and ack latency
+	bool
+	setData(const QString &spaceName, const MsgPack::Packed &tuples); // msgpack-encoded array of tuples, sent without re-encoding
+	bool
+	setBuilt(const QString &spaceName, MsgPack::TupleBuilder &&tuple, const bool bIfExist =true); // same as setData(tuple, bIfExist), the tuple is written by MsgPack::TupleBuilder
+	bool
+	setBuilt(const QString &spaceName, MsgPack::TupleBatch &&tuples); // same as setData(tuples), written by MsgPack::TupleBatch
+	bool
+	setDataPipelined(const QString &spaceName, const QList<QVariantList> &tuples, const int batchSize =1000); // same as setData(tuples), batches are encoded on QThreadPool while previous ones are on the wire
+	void
+	setBatchTuning(const int targetLatency =20, const int maxBatchBytes =16 * 1024 * 1024); // adaptive setData(): ack latency (ms) to keep and the largest batch
 	bool
 	insertData(const QString &spaceName, const QVariantList &tuple); // Insert only as new tuple by primary index, error - if exist.
 	bool
+	insertBuilt(const QString &spaceName, MsgPack::TupleBuilder &&tuple); // same as insertData(tuple), the tuple is written by MsgPack::TupleBuilder
+	bool
 	changeData(const QString &spaceName, const IndexKey &key, const int field, const QVariant &value, const QString &indexName =""); // change field value of tuple
 	bool
 	changeData(const QString &spaceName, const IndexKey &key, const Actions &actions, const QString &indexName ="");
 	bool
+	upsertData(const QString &spaceName, const QVariantList &tuple, const Actions &actions); // Insert 'tuple' if not exist (by primary index), else apply 'actions' to existing one.
+	bool
+	upsertData(const QString &spaceName, const QList<QVariantList> &tuples, const QList<QVariantList> &actions, QList<int> *failed =nullptr); // pipelined, one IPROTO_UPSERT per tuple, 'failed' - indexes of failed upserts
+	bool
 	deleteData(const QString &spaceName, const IndexKey &key, const QString &indexName =""); // Delete existing tuple (by any unique index). Return 'false' on error.
 	uint
 	getSpaceId(const QString &spaceName);
@@ -478,6 +684,8 @@ public:
 	getSpaceSize(const QString &spaceName);
 	const QVariantList &
 	spaces(); // all spaces and their attributes
+	void
+	resetSpaceFormats() { SpaceFormats.clear(); } // drop cached space formats (if changed not by this object)
 
 // *** Index ***
 	bool
@@ -496,30 +704,157 @@ public:
 	exec(const QString &script, const QVariantList &args ={});
 	const REPLY &
 	execSQL(const QString &query, const QVariantList &args ={}, const QVariantList &options ={});
+	bool
+	watch(const QString &key); // IPROTO_WATCH: signalEvent() on every change of the key broadcast by the server (box.broadcast())
+	bool
+	unwatch(const QString &key);
+
+// *** Cache ***
+	bool
+	enableCache(const QString &spaceName, const qint64 bytes =16 * 1024 * 1024, const QString &watchKey =""); // getData() by primary key (EQ) served from the client cache
+	void
+	disableCache(const QString &spaceName);
+	bool
+	installCacheTrigger(const QString &spaceName, const QString &watchKey =""); // server trigger broadcasting changes of the space
+	TupleCache::Stats
+	cacheStats(const QString &spaceName);
+
+// *** Change feed ***
+	QString
+	subscribe(const QString &spaceName, const ChangeHandler &handler, const QString &consumer ="", const int batchSize =1000, const int feedLimit =100000); // committed changes of the space in batches, returns the consumer (empty - error)
+	bool
+	unsubscribe(const QString &spaceName, const QString &consumer =""); // empty consumer - all of the space
+	bool
+	pollFeed(const QString &spaceName, const QString &consumer =""); // delivers the pending changes now (called on every feed event)
+	qint64
+	feedSequence(const QString &spaceName, const QString &consumer); // the last acknowledged change, -1 - not subscribed
+
+// *** Replication ***
+	bool
+	replicate(const QUIntMap &vclock ={}, const QString &instanceUuid =""); // anonymous replica: DML rows of the master WAL after 'vclock' ({} - its current vclock) by signalRow()
+	const QUIntMap &
+	replicaVclock() { return(ReplicaVclock); } // replica id : LSN of the received rows
+	bool
+	fetchSnapshot(const QStringList &spaceNames, const SnapshotHandler &handler); // IPROTO_FETCH_SNAPSHOT: tuples of the spaces from a consistent read view
+	bool
+	fetchSnapshot(const QStringList &spaceNames, const QString &fileName); // same into msgpack file: [[<space name>, <tuple>], ...]
+	const QUIntMap &
+	snapshotVclock() { return(SnapshotVclock); } // of the last fetched snapshot, replicate() continues from it
+	const MsgPack::Document &
+	execDocument(const QString &script, const QVariantList &args ={}); // reply as arena-backed document: <size>, <header>, <body>
 
 // ...
 	const ERROR &
 	getLastError() { return(lasterror); }
+	const PIPELINE_STATS &
+	getPipelineStats() { return(pipelinestats); }
 
 	int exec() =delete; // hide parent <exec> method
 
 private:
 	QUnSocket *socket;
 	QString version; // server version
+	int ProtocolVersion =0; // IPROTO_VERSION of the server
+	QSet<int> Features; // IPROTO_FEATURES of the server
 	QByteArray salt; // session salt
 	bool bInit =false;
 	quint64 syncId; // IPROTO syncId
 	ERROR lasterror;
+	PIPELINE_STATS pipelinestats;
 	QString UserName ="";
 	REPLY Reply;
+	MsgPack::Document ReplyDocument;
+	QByteArray RxBuffer; // received bytes of not yet completed packet
+	QHash<QString, MsgPack::Columns> SpaceFormats; // empty columns by space format, see getColumns()
+	QSet<QString> Predicates; // names of server functions of compiled predicate shapes, see filter()
+	int BatchTarget =20; // ms, adaptive setData()
+	int BatchMaxBytes =16 * 1024 * 1024;
+	int BatchBytes =64 * 1024; // current byte budget, kept between calls
+	QHash<QString, QSharedPointer<TupleCache>> Caches; // space : cache of primary key lookups, see enableCache()
+	QHash<QString, QString> CacheWatches; // watch key : space of the cache
+	QHash<QString, int> Watches; // key watched by IPROTO_WATCH : references (user, cache, change feed)
+	QVariantList CacheResult; // the tuples returned from a cache
+	struct Subscription
+	{
+		ChangeHandler Handler;
+		QString Consumer;	// cursor name in the server feed
+		int BatchSize;
+		int FeedLimit;
+		qint64 Seq;			// the last acknowledged change
+		bool bPolling =false;
+	};
+	QHash<QString, QHash<QString, Subscription>> Subscriptions; // space : consumer : subscription to the change feed, see subscribe()
+	QUIntMap ReplicaVclock;
+	QUIntMap SnapshotVclock;
+	QElapsedTimer ReplicaAck; // since the last vclock sent to the master
+	bool bReplicating =false; // the connection carries the rows of replicate() only
+	QTimer FeedTimer; // polls the change feeds when the server has no watchers
+	bool bBusy =false; // the reply is awaited: socket data is read by receive() only
 	const QVariantList LISTNULL ={};
 	const QVariantMap MAPNULL ={};
 	const QVariant VARNULL ={};
+	const MsgPack::Columns COLUMNSNULL ={};
 
 	const REPLY &
 	sendRequest(QUIntMap &header, const QUIntMap &body);
+	const REPLY &
+	setReply(const QByteArray &packet);
+	const MsgPack::Document &
+	sendRequestDocument(QUIntMap &header, const QByteArray &body);
+	QByteArray
+	transmit(QUIntMap &header, const QByteArray &body);
+	QByteArray
+	packet(QUIntMap &header, const QByteArray &body);
+	QByteArray
+	receive(const quint64 sync =0); // 0 - any packet
+	QByteArray
+	takePacket(bool &bLost);
+	bool
+	postWatch(const int requestType, const QString &key);
+	void
+	dispatchEvent(const QByteArray &packet);
+	void
+	dispatchRow(const QByteArray &packet);
+	bool
+	sendVclock();
+	uint
+	versionId(); // of the server: major.minor.patch as 0xMMmmpp
+	void
+	identify();
+	bool
+	fetchSnapshotRows(const QStringList &spaceNames, const std::function<bool(const QString &spaceName, const QByteArray &tuple)> &sink);
+	bool
+	receiveAck(QList<quint64> &inflight, quint64 *sync =nullptr);
 	qint64
 	send(const QByteArray &data);
+	bool
+	post(const QByteArray &data);
+	bool
+	write(const QByteArray &data); // post() of the replication stream itself
+	int
+	execRaw(const QString &script, QByteArray &packet, const QVariantList &args ={});
+	bool
+	execPacked(const QString &script, const QByteArray &args);
+	const REPLY &
+	execEncoded(const QByteArray &script, const QByteArray &args, const int requestType =IPROTO_EVAL);
+	QByteArray
+	evalBody(const QByteArray &script, const QByteArray &args, const int textKey =IPROTO_EXPR);
+	int
+	replyDataOffset(const QByteArray &packet);
+	const MsgPack::Columns &
+	spaceFormat(const QString &spaceName);
+	QString
+	setScript(const QString &spaceName, const bool bIfExist);
+	QString
+	batchScript(const QString &spaceName, const bool bArray =false);
+	bool
+	setDataAdaptive(const QString &spaceName, const QList<QVariantList> &tuples);
+	QString
+	selectIterator(const QString &spaceName, const Selector &selectorFrom, const Selector &selectorTo);
+	QString
+	selectScript(const QString &spaceName, const Selector &selectorFrom, const Selector &selectorTo, const uint limit, const QVariantList &fields ={});
+	Subscription *
+	subscription(const QString &spaceName, const QString &consumer);
 	inline void
 	setLastError(const ERROR &msg) {
 		lasterror =msg;
@@ -548,6 +883,7 @@ private:
 private slots:
 	void on_SocketConnected();
 	void on_SocketDisconnected();
+	void on_SocketReadyRead();
 	void on_SocketError(QUnSocket::SocketError error) {
 
 		setLastError({-1, QString("Socket error [%1].").arg(error)});
@@ -557,6 +893,9 @@ private slots:
 signals:
 	void signalConnected(const bool bConnected);
 	void error(const ERROR &msg);
+	void signalEvent(const QString &key, const QVariant &data); // IPROTO_EVENT of a watched key
+	void signalFeedLost(const QString &spaceName, const QString &consumer); // changes were dropped from the feed (or the server restarted): the consumer starts from the current change
+	void signalRow(const ROW &row); // row of replicate()
 };
 
 }
@@ -0,0 +1,99 @@
+/******************************************************************
+ * QTNT::ReadCoalescer - single-flight reads over QTarantool
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+ * license: GPLv3 2007 - https://www.gnu.org/licenses/gpl-3.0.html
+******************************************************************/
+#include "readcoalescer.h"
+
+using namespace QTNT;
+
+/****************************************************************************************
+ * The first thread becomes the leader of the read, the next ones with the same request
+ * wait for its result. The thread of 'tnt' never waits for other threads (their reads are
+ * queued to it), so there it reads on its own if the same read is in flight.
+****************************************************************************************/
+QVariantList
+ReadCoalescer::getData(const QString &spaceName, const IndexKey &key, const QVariantList &fields, const QString &indexName, ERROR *error)
+{
+const bool bOwnThread =(QThread::currentThread() == tnt->thread());
+QByteArray request =spaceName.toUtf8();
+
+	request +='\0';
+	request +=indexName.toUtf8();
+	request +='\0';
+	request +=MsgPack::pack(fields);
+	request +=key.encoding();
+
+QSharedPointer<Flight> flight;
+bool bLeader =false;
+
+	Mutex.lock();
+	flight =Flights.value(request);
+
+	if(!flight || bOwnThread)
+	{
+		flight =QSharedPointer<Flight>::create();
+		bLeader =true;
+		stat.Reads++;
+
+		if(!Flights.contains(request))
+			Flights.insert(request, flight);
+	}
+	else
+		stat.Shared++;
+
+	if(!bLeader)
+	{
+		while(!flight->bDone)
+			Done.wait(&Mutex);
+
+		Mutex.unlock();
+
+		if(error)
+			*error =flight->Error;
+
+	return(flight->Result);
+	}
+
+	Mutex.unlock();
+
+QVariantList result;
+ERROR failure ={0, ""};
+auto read =[&] {
+
+		result =tnt->getData(spaceName, {EQ, key, indexName}, {}, 1000, fields);
+
+		if(result.isEmpty())
+			failure =tnt->getLastError();
+	};
+
+	if(bOwnThread)
+		read();
+	else
+		QMetaObject::invokeMethod(tnt, read, Qt::BlockingQueuedConnection);
+
+	Mutex.lock();
+	flight->Result =result;
+	flight->Error =failure;
+	flight->bDone =true;
+
+	if(Flights.value(request) == flight)
+		Flights.remove(request);
+
+	Done.wakeAll();
+	Mutex.unlock();
+
+	if(error)
+		*error =failure;
+
+return(result);
+}
+
+ReadCoalescer::Stats
+ReadCoalescer::stats()
+{
+QMutexLocker lock(&Mutex);
+
+return(stat);
+}
@@ -0,0 +1,58 @@
+#pragma once
+/******************************************************************
+ * QTNT::ReadCoalescer - single-flight reads over QTarantool
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+ * license: GPLv3 2007 - https://www.gnu.org/licenses/gpl-3.0.html
+******************************************************************/
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSharedPointer>
+#include "qtarantool.h"
+
+namespace QTNT
+{
+/************************************************************************************************
+ * Reads by key shared by many threads. While a read of (space, index, key, fields) is in flight,
+ * the same requests of other threads wait for it and get its decoded result
+ * (QVariantList is implicitly shared, the tuples are not copied) instead of own round trip.
+ * The reads go to the server from the thread of 'tnt' (blocking queued call from other threads),
+ * so the connection is used by one thread only.
+ *
+ *	ReadCoalescer reader(&tnt);
+ *
+ *		// in any thread
+ *		const QVariantList tuples =reader.getData("Users", {userId});
+************************************************************************************************/
+class ReadCoalescer
+{
+public:
+	struct Stats
+	{
+		quint64 Reads =0;	// requests sent to the server
+		quint64 Shared =0;	// requests served by the read of other thread
+	};
+
+	explicit ReadCoalescer(QTarantool *tnt) : tnt(tnt) { } // 'tnt' must outlive the reader
+
+	QVariantList
+	getData(const QString &spaceName, const IndexKey &key, const QVariantList &fields ={}, const QString &indexName ="primary", ERROR *error =nullptr); // tuples with 'key' (EQ)
+	Stats
+	stats();
+
+private:
+	struct Flight
+	{
+		QVariantList Result;
+		ERROR Error ={0, ""};
+		bool bDone =false;
+	};
+
+	QTarantool *tnt;
+	QMutex Mutex; // guards Flights, Stats and the state of flights
+	QWaitCondition Done;
+	QHash<QByteArray, QSharedPointer<Flight>> Flights; // request : read in flight
+	Stats stat;
+};
+
+}
@@ -0,0 +1,164 @@
+/******************************************************************
+ * QTNT::TupleCache - client-side cache of tuples by primary key
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+ * license: GPLv3 2007 - https://www.gnu.org/licenses/gpl-3.0.html
+******************************************************************/
+#include "tuplecache.h"
+#include "lib/qmsgpack/msgpack.h"
+
+using namespace QTNT;
+
+namespace {
+
+const int ROWS =4;
+const int ENTRY_OVERHEAD =64; // hash node, list node, list header (approx.)
+const uint SEEDS[ROWS] ={0x9e3779b9, 0x85ebca6b, 0xc2b2ae35, 0x27d4eb2f};
+
+} // namespace
+/****************************************************************************************
+ * The sketch is sized by the expected quantity of entries (256 B per entry).
+****************************************************************************************/
+TupleCache::TupleCache(const qint64 capacity) : Capacity(qMax(capacity, qint64(0)))
+{
+const qint64 entries =qBound(qint64(1024), Capacity / 256, qint64(1) << 20);
+
+	Width =1;
+
+	while(Width < entries)
+		Width <<=1;
+
+	Sketch.fill(0, ROWS * Width);
+	SampleLimit =10 * static_cast<int>(entries);
+}
+
+bool
+TupleCache::find(const QByteArray &key, QVariantList &tuples)
+{
+	record(key);
+
+auto it =Entries.find(key);
+
+	if(it == Entries.end())
+	{
+		stat.Misses++;
+
+	return(false);
+	}
+
+	stat.Hits++;
+	Lru.splice(Lru.begin(), Lru, it->Lru);
+	tuples =it->Tuples;
+
+return(true);
+}
+/****************************************************************************************
+ * The victims are evicted only if the new entry is more frequent than all of them,
+ * otherwise the entry is rejected and no victim is evicted (a stale entry of the same
+ * key is dropped anyway).
+****************************************************************************************/
+void
+TupleCache::insert(const QByteArray &key, const QVariantList &tuples, const quint64 generation)
+{
+	if(generation != Generation) // cleared while the tuples were read
+		return;
+
+const int bytes =key.size() + MsgPack::pack(tuples).size() + ENTRY_OVERHEAD;
+auto it =Entries.find(key);
+
+	if(it != Entries.end()) // replaced
+	{
+		stat.Bytes -=it->Bytes;
+		Lru.erase(it->Lru);
+		Entries.erase(it);
+	}
+
+	if(bytes > Capacity)
+	{
+		stat.Rejections++;
+		stat.Entries =Entries.size();
+
+	return;
+	}
+
+const int freq =frequency(key);
+qint64 freed =0;
+
+	for(auto victim =Lru.rbegin(); stat.Bytes - freed + bytes > Capacity; ++victim)
+	{
+		if(freq <= frequency(*victim))
+		{
+			stat.Rejections++;
+			stat.Entries =Entries.size();
+
+		return;
+		}
+
+		freed +=Entries.value(*victim).Bytes;
+	}
+
+	while(freed > 0)
+	{
+		freed -=Entries.value(Lru.back()).Bytes;
+		evict();
+	}
+
+	Lru.push_front(key);
+	Entries.insert(key, {tuples, bytes, Lru.begin()});
+	stat.Bytes +=bytes;
+	stat.Entries =Entries.size();
+}
+
+void
+TupleCache::evict()
+{
+	stat.Bytes -=Entries.value(Lru.back()).Bytes;
+	stat.Evictions++;
+	Entries.remove(Lru.back());
+	Lru.pop_back();
+}
+
+void
+TupleCache::clear()
+{
+	Entries.clear();
+	Lru.clear();
+	Generation++;
+	stat.Invalidations++;
+	stat.Entries =0;
+	stat.Bytes =0;
+}
+/****************************************************************************************
+ * Count-Min sketch: the counter of every row is incremented (saturated at 15),
+ * all counters are halved after 'SampleLimit' records (aging).
+****************************************************************************************/
+void
+TupleCache::record(const QByteArray &key)
+{
+	for(int r =0; r < ROWS; r++)
+	{
+	quint8 &counter =Sketch[r * Width + (qHash(key, SEEDS[r]) & (Width - 1))];
+
+		if(counter < 15)
+			counter++;
+	}
+
+	if(++Samples >= SampleLimit)
+	{
+		for(auto &counter : Sketch)
+			counter >>=1;
+
+		Samples /=2;
+	}
+}
+
+int
+TupleCache::frequency(const QByteArray &key) const
+{
+int freq =15;
+
+	for(int r =0; r < ROWS; r++)
+		freq =qMin(freq, int(Sketch[r * Width + (qHash(key, SEEDS[r]) & (Width - 1))]));
+
+return(freq);
+}
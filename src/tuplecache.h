@@ -0,0 +1,80 @@
+#pragma once
+/******************************************************************
+ * QTNT::TupleCache - client-side cache of tuples by primary key
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+ * license: GPLv3 2007 - https://www.gnu.org/licenses/gpl-3.0.html
+******************************************************************/
+#include <QByteArray>
+#include <QHash>
+#include <QVector>
+#include <QVariant>
+#include <list>
+
+namespace QTNT
+{
+/************************************************************************************************
+ * LRU of results of primary key lookups (key - msgpack encoding of IndexKey) within a byte budget.
+ * Admission is TinyLFU: a new entry takes the place of the LRU victim only if its key was
+ * requested more often (frequencies are estimated by a Count-Min sketch of 4-bit counters,
+ * halved every 10 x <entries> requests), so one-time keys do not flush hot ones.
+ * An entry read before clear() (generation) is not inserted after it.
+ * Not thread-safe: used by QTarantool in its thread (see QTarantool::enableCache()).
+************************************************************************************************/
+class TupleCache
+{
+public:
+	struct Stats
+	{
+		quint64 Hits =0;
+		quint64 Misses =0;
+		quint64 Evictions =0;		// entries removed for new ones
+		quint64 Rejections =0;		// entries not admitted (colder than the victim or too big)
+		quint64 Invalidations =0;	// clear() calls
+		int Entries =0;
+		qint64 Bytes =0;
+
+		double
+		hitRate() const { return(Hits + Misses ? double(Hits) / (Hits + Misses) : 0); }
+	};
+
+	explicit TupleCache(const qint64 capacity);
+
+	bool
+	find(const QByteArray &key, QVariantList &tuples); // counts the request of 'key'
+	void
+	insert(const QByteArray &key, const QVariantList &tuples, const quint64 generation);
+	void
+	clear(); // all entries are invalid, the frequencies are kept
+	inline quint64
+	generation() const { return(Generation); }
+	inline const Stats &
+	stats() const { return(stat); }
+
+private:
+	struct Entry
+	{
+		QVariantList Tuples;
+		int Bytes;
+		std::list<QByteArray>::iterator Lru;
+	};
+
+	qint64 Capacity;
+	quint64 Generation =0;
+	QHash<QByteArray, Entry> Entries;
+	std::list<QByteArray> Lru; // front - the most recent
+	QVector<quint8> Sketch; // 4 rows of 4-bit counters (a byte per counter)
+	uint Width; // counters per row, power of 2
+	int Samples =0;
+	int SampleLimit;
+	Stats stat;
+
+	void
+	record(const QByteArray &key);
+	int
+	frequency(const QByteArray &key) const;
+	void
+	evict();
+};
+
+}
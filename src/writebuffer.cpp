@@ -0,0 +1,193 @@
+/******************************************************************
+ * QTNT::WriteBuffer - write-behind buffer of tuples for QTarantool
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+ * license: GPLv3 2007 - https://www.gnu.org/licenses/gpl-3.0.html
+******************************************************************/
+#include "writebuffer.h"
+
+using namespace QTNT;
+
+WriteBuffer::WriteBuffer(QTarantool *tnt, QObject *parent) : QObject(parent), tnt(tnt), Timer(this)
+{
+	Timer.setSingleShot(true);
+	connect(&Timer, &QTimer::timeout, this, &WriteBuffer::flush);
+}
+
+bool
+WriteBuffer::append(const QString &spaceName, const QVariantList &tuple)
+{
+QMutexLocker lock(&Mutex);
+
+	if(Bytes >= MaxBytes)
+	{
+		bFull =true;
+		return(false);
+	}
+
+MsgPack::TupleBatch &batch =Batches[spaceName];
+const int size =(batch.count() ? batch.data().size() : 0); // the header of a new batch is counted too
+
+	batch << QVariant(tuple);
+	added(spaceName, batch, size);
+
+return(true);
+}
+
+bool
+WriteBuffer::append(const QString &spaceName, MsgPack::TupleBuilder &&tuple)
+{
+QMutexLocker lock(&Mutex);
+
+	if(Bytes >= MaxBytes)
+	{
+		bFull =true;
+		return(false);
+	}
+
+MsgPack::TupleBatch &batch =Batches[spaceName];
+const int size =(batch.count() ? batch.data().size() : 0); // the header of a new batch is counted too
+
+	batch.append(std::move(tuple));
+	added(spaceName, batch, size);
+
+return(true);
+}
+/****************************************************************************************
+ * Called under the lock. The flush itself is queued to the thread of the buffer,
+ * so append() never waits for the server.
+****************************************************************************************/
+void
+WriteBuffer::added(const QString &spaceName, const MsgPack::TupleBatch &batch, const int sizeBefore)
+{
+const bool bFirst =(Bytes == 0);
+
+	Bytes +=batch.data().size() - sizeBefore;
+
+	if(batch.data().size() >= FlushBytes || batch.count() >= FlushCount)
+	{
+		Due.insert(spaceName);
+
+		if(!bRequested)
+		{
+			bRequested =true;
+			QMetaObject::invokeMethod(this, [this] { flushDue(); }, Qt::QueuedConnection);
+		}
+	}
+	else
+	if(bFirst)
+		QMetaObject::invokeMethod(this, [this] { if(!Timer.isActive()) Timer.start(FlushDelay); }, Qt::QueuedConnection);
+}
+
+void
+WriteBuffer::flushDue()
+{
+QSet<QString> spaces;
+
+	Mutex.lock();
+	spaces.swap(Due);
+	bRequested =false;
+	Mutex.unlock();
+
+	for(const auto &space : spaces)
+		flushSpace(space);
+}
+
+bool
+WriteBuffer::flush()
+{
+	Timer.stop();
+
+	Mutex.lock();
+const QStringList spaces =Batches.keys();
+	Due.clear();
+	Mutex.unlock();
+
+bool result =true;
+
+	for(const auto &space : spaces)
+		result &=flushSpace(space);
+
+return(result);
+}
+/****************************************************************************************
+ * The batch is taken out under the lock and written without it:
+ * producers fill a new batch of the space meanwhile.
+****************************************************************************************/
+bool
+WriteBuffer::flushSpace(const QString &spaceName)
+{
+	Mutex.lock();
+
+	if(!Batches.contains(spaceName))
+	{
+		Mutex.unlock();
+		return(true);
+	}
+
+MsgPack::TupleBatch batch =Batches.take(spaceName);
+const int tuples =batch.count();
+
+	Bytes -=batch.data().size();
+
+const bool bReady =(bFull && Bytes < MaxBytes / 2);
+const bool bLeft =(Bytes > 0); // tuples of other spaces or new ones
+
+	if(bReady)
+		bFull =false;
+
+	Mutex.unlock();
+
+const bool result =tnt->setBuilt(spaceName, std::move(batch));
+
+	if(result)
+		emit signalFlushed(spaceName, tuples);
+	else
+		emit signalFlushFailed(spaceName, tuples, tnt->getLastError());
+
+	if(bReady)
+		emit signalReady();
+
+	if(bLeft && !Timer.isActive())
+		Timer.start(FlushDelay);
+
+return(result);
+}
+
+void
+WriteBuffer::setThresholds(const int flushBytes, const int flushCount, const int flushDelay)
+{
+QMutexLocker lock(&Mutex);
+
+	FlushBytes =qMax(flushBytes, 1);
+	FlushCount =qMax(flushCount, 1);
+	FlushDelay =qMax(flushDelay, 0);
+}
+
+void
+WriteBuffer::setMaxBytes(const qint64 bytes)
+{
+QMutexLocker lock(&Mutex);
+
+	MaxBytes =qMax(bytes, qint64(FlushBytes));
+}
+
+qint64
+WriteBuffer::bytes()
+{
+QMutexLocker lock(&Mutex);
+
+return(Bytes);
+}
+
+int
+WriteBuffer::count()
+{
+QMutexLocker lock(&Mutex);
+int tuples =0;
+
+	for(const auto &batch : qAsConst(Batches))
+		tuples +=batch.count();
+
+return(tuples);
+}
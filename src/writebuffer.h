@@ -0,0 +1,77 @@
+#pragma once
+/******************************************************************
+ * QTNT::WriteBuffer - write-behind buffer of tuples for QTarantool
+ *
+ * src: https://github.com/JohnMcLaren/QTarantool
+ * license: GPLv3 2007 - https://www.gnu.org/licenses/gpl-3.0.html
+******************************************************************/
+#include <QMutex>
+#include "qtarantool.h"
+
+namespace QTNT
+{
+/************************************************************************************************
+ * Collects tuples per space and writes them by batched replaces (QTarantool::setBuilt(space, TupleBatch &&)).
+ * append() only encodes the tuple into the batch of its space and returns, it can be called
+ * from any thread. The batches are written from the thread of the buffer (and its connection)
+ * when a batch reaches 'flushBytes' or 'flushCount', or 'flushDelay' ms after the first tuple.
+ * Memory is bounded by setMaxBytes(): append() returns 'false' while the buffer is full,
+ * signalReady() is emitted when it is below half of the bound again.
+ * A failed batch is dropped and reported by signalFlushFailed().
+ *
+ *	WriteBuffer wb(&tnt);
+ *
+ *		connect(&wb, &WriteBuffer::signalFlushFailed, this, &MyClass::on_FlushFailed);
+ *		wb.append("Events", {id, ts, "click"});
+************************************************************************************************/
+class WriteBuffer : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit WriteBuffer(QTarantool *tnt, QObject *parent =nullptr); // 'tnt' must outlive the buffer
+	~WriteBuffer() { flush(); }
+
+	bool
+	append(const QString &spaceName, const QVariantList &tuple);
+	bool
+	append(const QString &spaceName, MsgPack::TupleBuilder &&tuple);
+	bool
+	flush(); // writes all batches now (from the thread of the buffer), 'false' - some batch failed
+	void
+	setThresholds(const int flushBytes =256 * 1024, const int flushCount =1000, const int flushDelay =50); // per space batch: bytes, tuples, ms
+	void
+	setMaxBytes(const qint64 bytes =32 * 1024 * 1024); // of all batches
+	qint64
+	bytes(); // encoded tuples waiting for flush
+	int
+	count(); // tuples waiting for flush
+
+private:
+	QTarantool *tnt;
+	QMutex Mutex; // guards Batches, Due and counters
+	QHash<QString, MsgPack::TupleBatch> Batches;
+	QSet<QString> Due; // spaces over the thresholds
+	QTimer Timer;
+	qint64 Bytes =0;
+	qint64 MaxBytes =32 * 1024 * 1024;
+	int FlushBytes =256 * 1024;
+	int FlushCount =1000;
+	int FlushDelay =50;
+	bool bFull =false;
+	bool bRequested =false; // flush of Due is queued
+
+	void
+	added(const QString &spaceName, const MsgPack::TupleBatch &batch, const int sizeBefore);
+	bool
+	flushSpace(const QString &spaceName);
+	void
+	flushDue();
+
+signals:
+	void signalFlushed(const QString &spaceName, const int tuples);
+	void signalFlushFailed(const QString &spaceName, const int tuples, const ERROR &msg);
+	void signalReady(); // the buffer accepts tuples again
+};
+
+}